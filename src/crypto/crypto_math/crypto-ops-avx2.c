@@ -0,0 +1,668 @@
+/* Four independent group operations in lock-step using AVX2.
+ *
+ * A field element of each of the four points lives in one 64-bit lane of ten
+ * __m256i registers (limb i of all four points in register i), using ref10's
+ * radix 2^25.5 so that every limb product is a single _mm256_mul_epu32.
+ * Limbs are kept unsigned; subtraction adds a multiple of p first.
+ *
+ * Bounds: fe4_mul/fe4_sq/fe4_sub outputs are carried (limbs below 2^26 and
+ * 2^25, limbs 1 and 5 may exceed by 2^18), fe4_add does not carry.
+ * Multiplication inputs may have limbs up to 3*2^26 (19 times the limb has to
+ * fit in 32 bits), fe4_sq inputs up to 2^27. The subtrahend of fe4_sub has to
+ * be below 4p limb-wise, the argument of fe4_neg_limb below 2p (carried).
+ *
+ * All lanes follow the same sequence of operations, with the digits of the
+ * four scalars in fixed 4-bit windows and table lookups done by masking
+ * across lanes. Points enter and leave through fe_tobytes so this works with
+ * either field backend. The entry points take already recoded scalars and are
+ * only called from the *_batch functions in crypto-ops.c.
+ */
+
+#include <string.h>
+
+#include "crypto-ops.h"
+
+#if defined(CRYPTO_OPS_AVX2)
+
+#include <immintrin.h>
+#include <pthread.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+typedef struct {
+  __m256i v[10];
+} fe4;
+
+/* p2 uses X, Y and Z only */
+typedef struct {
+  fe4 X;
+  fe4 Y;
+  fe4 Z;
+  fe4 T;
+} ge4_p3;
+
+typedef struct {
+  fe4 X;
+  fe4 Y;
+  fe4 Z;
+  fe4 T;
+} ge4_p1p1;
+
+typedef struct {
+  fe4 yplusx;
+  fe4 yminusx;
+  fe4 xy2d;
+} ge4_precomp;
+
+typedef struct {
+  fe4 YplusX;
+  fe4 YminusX;
+  fe4 Z;
+  fe4 T2d;
+} ge4_cached;
+
+/* A precomputed multiple of B with the limbs of yplusx, yminusx and xy2d as
+ * 64-bit words, ready to be broadcast into all four lanes.
+ */
+typedef uint64_t precomp25[3][10];
+
+int ge_avx2_available(void) {
+  static int available = -1;
+  if (available < 0) {
+    available = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return available;
+}
+
+/* Scalar conversions */
+
+static const unsigned char fe25_pos[10] = { 0, 26, 51, 77, 102, 128, 153, 179, 204, 230 };
+
+/* Canonical limbs of f */
+static void fe25_from_fe(uint64_t *h, const fe f) {
+  unsigned char s[32];
+  uint64_t w[4];
+  int i, j;
+
+  fe_tobytes(s, f);
+  for (i = 0; i < 4; i++) {
+    w[i] = 0;
+    for (j = 0; j < 8; j++) {
+      w[i] |= ((uint64_t) s[8 * i + j]) << (8 * j);
+    }
+  }
+  for (i = 0; i < 10; i++) {
+    int k = fe25_pos[i] >> 6, o = fe25_pos[i] & 63;
+    uint64_t x = w[k] >> o;
+    if (o != 0 && k < 3) {
+      x |= w[k + 1] << (64 - o);
+    }
+    h[i] = x & ((i & 1) ? 0x1ffffff : 0x3ffffff);
+  }
+}
+
+/* Carried limbs back to the field backend's representation */
+static void fe_from25(fe h, const uint64_t *t) {
+  int i;
+#if defined(CRYPTO_OPS_FE51)
+  for (i = 0; i < 5; i++) {
+    h[i] = t[2 * i] + (t[2 * i + 1] << 26);
+  }
+#else
+  /* ref10 expects signed limbs of at most 2^25 (2^24 for odd limbs), so
+   * recentre them the way fe_mul's final carries do */
+  int64_t l[10];
+  int64_t c;
+  for (i = 0; i < 10; i++) {
+    l[i] = (int64_t) t[i];
+  }
+  for (i = 0; i < 10; i++) {
+    if (i & 1) {
+      c = (l[i] + (int64_t) (1L << 24)) >> 25;
+      l[i] -= c << 25;
+    } else {
+      c = (l[i] + (int64_t) (1L << 25)) >> 26;
+      l[i] -= c << 26;
+    }
+    if (i == 9) {
+      l[0] += c * 19;
+    } else {
+      l[i + 1] += c;
+    }
+  }
+  c = (l[0] + (int64_t) (1L << 25)) >> 26;
+  l[0] -= c << 26;
+  l[1] += c;
+  for (i = 0; i < 10; i++) {
+    h[i] = (int32_t) l[i];
+  }
+#endif
+}
+
+/* Field arithmetic */
+
+AVX2 static inline void fe4_0(fe4 *h) {
+  int i;
+  for (i = 0; i < 10; i++) {
+    h->v[i] = _mm256_setzero_si256();
+  }
+}
+
+AVX2 static inline void fe4_1(fe4 *h) {
+  fe4_0(h);
+  h->v[0] = _mm256_set1_epi64x(1);
+}
+
+AVX2 static inline void fe4_add(fe4 *h, const fe4 *f, const fe4 *g) {
+  int i;
+  for (i = 0; i < 10; i++) {
+    h->v[i] = _mm256_add_epi64(f->v[i], g->v[i]);
+  }
+}
+
+#define ADD(a, b) _mm256_add_epi64(a, b)
+#define MUL(a, b) _mm256_mul_epu32(a, b)
+#define MAC(h, a, b) h = _mm256_add_epi64(h, _mm256_mul_epu32(a, b))
+
+/* Carry 64-bit column sums into ten limbs, two chains interleaved as in
+ * ref10. The top carry is folded back times 19.
+ */
+AVX2 static inline void fe4_carry(fe4 *h, __m256i h0, __m256i h1, __m256i h2, __m256i h3, __m256i h4,
+                                  __m256i h5, __m256i h6, __m256i h7, __m256i h8, __m256i h9) {
+  const __m256i m26 = _mm256_set1_epi64x(0x3ffffff);
+  const __m256i m25 = _mm256_set1_epi64x(0x1ffffff);
+  __m256i c;
+
+#define FE4_CARRY(i, j, bits, m) \
+  c = _mm256_srli_epi64(h##i, bits); h##j = ADD(h##j, c); h##i = _mm256_and_si256(h##i, m);
+
+  FE4_CARRY(0, 1, 26, m26) FE4_CARRY(4, 5, 26, m26)
+  FE4_CARRY(1, 2, 25, m25) FE4_CARRY(5, 6, 25, m25)
+  FE4_CARRY(2, 3, 26, m26) FE4_CARRY(6, 7, 26, m26)
+  FE4_CARRY(3, 4, 25, m25) FE4_CARRY(7, 8, 25, m25)
+  FE4_CARRY(4, 5, 26, m26) FE4_CARRY(8, 9, 26, m26)
+
+  /* the carry out of h9 can be wider than 32 bits, so no multiply here */
+  c = _mm256_srli_epi64(h9, 25);
+  h9 = _mm256_and_si256(h9, m25);
+  h0 = ADD(h0, ADD(c, ADD(_mm256_slli_epi64(c, 1), _mm256_slli_epi64(c, 4))));
+  FE4_CARRY(0, 1, 26, m26)
+
+#undef FE4_CARRY
+
+  h->v[0] = h0;
+  h->v[1] = h1;
+  h->v[2] = h2;
+  h->v[3] = h3;
+  h->v[4] = h4;
+  h->v[5] = h5;
+  h->v[6] = h6;
+  h->v[7] = h7;
+  h->v[8] = h8;
+  h->v[9] = h9;
+}
+
+/* h = f + 4p - g */
+AVX2 static inline void fe4_sub(fe4 *h, const fe4 *f, const fe4 *g) {
+  const __m256i p0 = _mm256_set1_epi64x(0xfffffb4);
+  const __m256i pe = _mm256_set1_epi64x(0xffffffc);
+  const __m256i po = _mm256_set1_epi64x(0x7fffffc);
+
+  fe4_carry(h,
+    _mm256_sub_epi64(ADD(f->v[0], p0), g->v[0]), _mm256_sub_epi64(ADD(f->v[1], po), g->v[1]),
+    _mm256_sub_epi64(ADD(f->v[2], pe), g->v[2]), _mm256_sub_epi64(ADD(f->v[3], po), g->v[3]),
+    _mm256_sub_epi64(ADD(f->v[4], pe), g->v[4]), _mm256_sub_epi64(ADD(f->v[5], po), g->v[5]),
+    _mm256_sub_epi64(ADD(f->v[6], pe), g->v[6]), _mm256_sub_epi64(ADD(f->v[7], po), g->v[7]),
+    _mm256_sub_epi64(ADD(f->v[8], pe), g->v[8]), _mm256_sub_epi64(ADD(f->v[9], po), g->v[9]));
+}
+
+/* h = 2p - f, without carrying */
+AVX2 static inline __m256i fe4_neg_limb(__m256i f, int i) {
+  const __m256i p = _mm256_set1_epi64x(i == 0 ? 0x7ffffda : (i & 1) ? 0x3fffffe : 0x7fffffe);
+  return _mm256_sub_epi64(p, f);
+}
+
+AVX2 static void fe4_mul(fe4 *h, const fe4 *f, const fe4 *g) {
+  const __m256i n19 = _mm256_set1_epi64x(19);
+  __m256i f0 = f->v[0], f1 = f->v[1], f2 = f->v[2], f3 = f->v[3], f4 = f->v[4];
+  __m256i f5 = f->v[5], f6 = f->v[6], f7 = f->v[7], f8 = f->v[8], f9 = f->v[9];
+  __m256i g0 = g->v[0], g1 = g->v[1], g2 = g->v[2], g3 = g->v[3], g4 = g->v[4];
+  __m256i g5 = g->v[5], g6 = g->v[6], g7 = g->v[7], g8 = g->v[8], g9 = g->v[9];
+  __m256i g1_19 = MUL(g1, n19), g2_19 = MUL(g2, n19), g3_19 = MUL(g3, n19);
+  __m256i g4_19 = MUL(g4, n19), g5_19 = MUL(g5, n19), g6_19 = MUL(g6, n19);
+  __m256i g7_19 = MUL(g7, n19), g8_19 = MUL(g8, n19), g9_19 = MUL(g9, n19);
+  /* odd*odd limb products carry an extra factor 2 in radix 2^25.5 */
+  __m256i f1_2 = ADD(f1, f1), f3_2 = ADD(f3, f3), f5_2 = ADD(f5, f5);
+  __m256i f7_2 = ADD(f7, f7), f9_2 = ADD(f9, f9);
+  __m256i h0, h1, h2, h3, h4, h5, h6, h7, h8, h9;
+
+  h0 = MUL(f0, g0); MAC(h0, f1_2, g9_19); MAC(h0, f2, g8_19); MAC(h0, f3_2, g7_19); MAC(h0, f4, g6_19);
+  MAC(h0, f5_2, g5_19); MAC(h0, f6, g4_19); MAC(h0, f7_2, g3_19); MAC(h0, f8, g2_19); MAC(h0, f9_2, g1_19);
+  h1 = MUL(f0, g1); MAC(h1, f1, g0); MAC(h1, f2, g9_19); MAC(h1, f3, g8_19); MAC(h1, f4, g7_19);
+  MAC(h1, f5, g6_19); MAC(h1, f6, g5_19); MAC(h1, f7, g4_19); MAC(h1, f8, g3_19); MAC(h1, f9, g2_19);
+  h2 = MUL(f0, g2); MAC(h2, f1_2, g1); MAC(h2, f2, g0); MAC(h2, f3_2, g9_19); MAC(h2, f4, g8_19);
+  MAC(h2, f5_2, g7_19); MAC(h2, f6, g6_19); MAC(h2, f7_2, g5_19); MAC(h2, f8, g4_19); MAC(h2, f9_2, g3_19);
+  h3 = MUL(f0, g3); MAC(h3, f1, g2); MAC(h3, f2, g1); MAC(h3, f3, g0); MAC(h3, f4, g9_19);
+  MAC(h3, f5, g8_19); MAC(h3, f6, g7_19); MAC(h3, f7, g6_19); MAC(h3, f8, g5_19); MAC(h3, f9, g4_19);
+  h4 = MUL(f0, g4); MAC(h4, f1_2, g3); MAC(h4, f2, g2); MAC(h4, f3_2, g1); MAC(h4, f4, g0);
+  MAC(h4, f5_2, g9_19); MAC(h4, f6, g8_19); MAC(h4, f7_2, g7_19); MAC(h4, f8, g6_19); MAC(h4, f9_2, g5_19);
+  h5 = MUL(f0, g5); MAC(h5, f1, g4); MAC(h5, f2, g3); MAC(h5, f3, g2); MAC(h5, f4, g1);
+  MAC(h5, f5, g0); MAC(h5, f6, g9_19); MAC(h5, f7, g8_19); MAC(h5, f8, g7_19); MAC(h5, f9, g6_19);
+  h6 = MUL(f0, g6); MAC(h6, f1_2, g5); MAC(h6, f2, g4); MAC(h6, f3_2, g3); MAC(h6, f4, g2);
+  MAC(h6, f5_2, g1); MAC(h6, f6, g0); MAC(h6, f7_2, g9_19); MAC(h6, f8, g8_19); MAC(h6, f9_2, g7_19);
+  h7 = MUL(f0, g7); MAC(h7, f1, g6); MAC(h7, f2, g5); MAC(h7, f3, g4); MAC(h7, f4, g3);
+  MAC(h7, f5, g2); MAC(h7, f6, g1); MAC(h7, f7, g0); MAC(h7, f8, g9_19); MAC(h7, f9, g8_19);
+  h8 = MUL(f0, g8); MAC(h8, f1_2, g7); MAC(h8, f2, g6); MAC(h8, f3_2, g5); MAC(h8, f4, g4);
+  MAC(h8, f5_2, g3); MAC(h8, f6, g2); MAC(h8, f7_2, g1); MAC(h8, f8, g0); MAC(h8, f9_2, g9_19);
+  h9 = MUL(f0, g9); MAC(h9, f1, g8); MAC(h9, f2, g7); MAC(h9, f3, g6); MAC(h9, f4, g5);
+  MAC(h9, f5, g4); MAC(h9, f6, g3); MAC(h9, f7, g2); MAC(h9, f8, g1); MAC(h9, f9, g0);
+
+  fe4_carry(h, h0, h1, h2, h3, h4, h5, h6, h7, h8, h9);
+}
+
+AVX2 static void fe4_sq(fe4 *h, const fe4 *f) {
+  const __m256i n19 = _mm256_set1_epi64x(19);
+  __m256i f0 = f->v[0], f1 = f->v[1], f2 = f->v[2], f3 = f->v[3], f4 = f->v[4];
+  __m256i f5 = f->v[5], f6 = f->v[6], f7 = f->v[7], f8 = f->v[8], f9 = f->v[9];
+  __m256i f0_2 = ADD(f0, f0), f1_2 = ADD(f1, f1), f2_2 = ADD(f2, f2), f3_2 = ADD(f3, f3);
+  __m256i f4_2 = ADD(f4, f4), f5_2 = ADD(f5, f5), f6_2 = ADD(f6, f6), f7_2 = ADD(f7, f7);
+  __m256i f8_2 = ADD(f8, f8), f9_2 = ADD(f9, f9);
+  __m256i f1_4 = ADD(f1_2, f1_2), f3_4 = ADD(f3_2, f3_2), f5_4 = ADD(f5_2, f5_2), f7_4 = ADD(f7_2, f7_2);
+  __m256i f5_19 = MUL(f5, n19), f6_19 = MUL(f6, n19), f7_19 = MUL(f7, n19);
+  __m256i f8_19 = MUL(f8, n19), f9_19 = MUL(f9, n19);
+  __m256i h0, h1, h2, h3, h4, h5, h6, h7, h8, h9;
+
+  h0 = MUL(f0, f0); MAC(h0, f1_4, f9_19); MAC(h0, f2_2, f8_19); MAC(h0, f3_4, f7_19); MAC(h0, f4_2, f6_19);
+  MAC(h0, f5_2, f5_19);
+  h1 = MUL(f0_2, f1); MAC(h1, f2_2, f9_19); MAC(h1, f3_2, f8_19); MAC(h1, f4_2, f7_19); MAC(h1, f5_2, f6_19);
+  h2 = MUL(f0_2, f2); MAC(h2, f1_2, f1); MAC(h2, f3_4, f9_19); MAC(h2, f4_2, f8_19); MAC(h2, f5_4, f7_19);
+  MAC(h2, f6, f6_19);
+  h3 = MUL(f0_2, f3); MAC(h3, f1_2, f2); MAC(h3, f4_2, f9_19); MAC(h3, f5_2, f8_19); MAC(h3, f6_2, f7_19);
+  h4 = MUL(f0_2, f4); MAC(h4, f1_4, f3); MAC(h4, f2, f2); MAC(h4, f5_4, f9_19); MAC(h4, f6_2, f8_19);
+  MAC(h4, f7_2, f7_19);
+  h5 = MUL(f0_2, f5); MAC(h5, f1_2, f4); MAC(h5, f2_2, f3); MAC(h5, f6_2, f9_19); MAC(h5, f7_2, f8_19);
+  h6 = MUL(f0_2, f6); MAC(h6, f1_4, f5); MAC(h6, f2_2, f4); MAC(h6, f3_2, f3); MAC(h6, f7_4, f9_19);
+  MAC(h6, f8, f8_19);
+  h7 = MUL(f0_2, f7); MAC(h7, f1_2, f6); MAC(h7, f2_2, f5); MAC(h7, f3_2, f4); MAC(h7, f8_2, f9_19);
+  h8 = MUL(f0_2, f8); MAC(h8, f1_4, f7); MAC(h8, f2_2, f6); MAC(h8, f3_4, f5); MAC(h8, f4, f4);
+  MAC(h8, f9_2, f9_19);
+  h9 = MUL(f0_2, f9); MAC(h9, f1_2, f8); MAC(h9, f2_2, f7); MAC(h9, f3_2, f6); MAC(h9, f4_2, f5);
+
+  fe4_carry(h, h0, h1, h2, h3, h4, h5, h6, h7, h8, h9);
+}
+
+AVX2 static inline void fe4_sq2(fe4 *h, const fe4 *f) {
+  fe4_sq(h, f);
+  fe4_add(h, h, h);
+}
+
+/* Conversions between the four lanes and single points */
+
+AVX2 static void fe4_load(fe4 *h, const fe f0, const fe f1, const fe f2, const fe f3) {
+  uint64_t t[4][10];
+  int i;
+
+  fe25_from_fe(t[0], f0);
+  fe25_from_fe(t[1], f1);
+  fe25_from_fe(t[2], f2);
+  fe25_from_fe(t[3], f3);
+  for (i = 0; i < 10; i++) {
+    h->v[i] = _mm256_set_epi64x(t[3][i], t[2][i], t[1][i], t[0][i]);
+  }
+}
+
+AVX2 static void fe4_const(fe4 *h, const fe f) {
+  fe4_load(h, f, f, f, f);
+}
+
+/* Requires h to be carried */
+AVX2 static void fe4_store(fe f0, fe f1, fe f2, fe f3, const fe4 *h) {
+  uint64_t t[4][10];
+  int i;
+
+  for (i = 0; i < 10; i++) {
+    uint64_t l[4];
+    _mm256_storeu_si256((__m256i *) l, h->v[i]);
+    t[0][i] = l[0];
+    t[1][i] = l[1];
+    t[2][i] = l[2];
+    t[3][i] = l[3];
+  }
+  fe_from25(f0, t[0]);
+  fe_from25(f1, t[1]);
+  fe_from25(f2, t[2]);
+  fe_from25(f3, t[3]);
+}
+
+/* Group arithmetic, as in crypto-ops.c */
+
+AVX2 static void ge4_p3_load(ge4_p3 *r, const ge_p3 *p) {
+  fe4_load(&r->X, p[0].X, p[1].X, p[2].X, p[3].X);
+  fe4_load(&r->Y, p[0].Y, p[1].Y, p[2].Y, p[3].Y);
+  fe4_load(&r->Z, p[0].Z, p[1].Z, p[2].Z, p[3].Z);
+  fe4_load(&r->T, p[0].T, p[1].T, p[2].T, p[3].T);
+}
+
+AVX2 static void ge4_p3_store(ge_p3 *r, const ge4_p3 *p) {
+  fe4_store(r[0].X, r[1].X, r[2].X, r[3].X, &p->X);
+  fe4_store(r[0].Y, r[1].Y, r[2].Y, r[3].Y, &p->Y);
+  fe4_store(r[0].Z, r[1].Z, r[2].Z, r[3].Z, &p->Z);
+  fe4_store(r[0].T, r[1].T, r[2].T, r[3].T, &p->T);
+}
+
+AVX2 static void ge4_p3_0(ge4_p3 *h) {
+  fe4_0(&h->X);
+  fe4_1(&h->Y);
+  fe4_1(&h->Z);
+  fe4_0(&h->T);
+}
+
+AVX2 static void ge4_p1p1_to_p2(ge4_p3 *r, const ge4_p1p1 *p) {
+  fe4_mul(&r->X, &p->X, &p->T);
+  fe4_mul(&r->Y, &p->Y, &p->Z);
+  fe4_mul(&r->Z, &p->Z, &p->T);
+}
+
+AVX2 static void ge4_p1p1_to_p3(ge4_p3 *r, const ge4_p1p1 *p) {
+  fe4_mul(&r->X, &p->X, &p->T);
+  fe4_mul(&r->Y, &p->Y, &p->Z);
+  fe4_mul(&r->Z, &p->Z, &p->T);
+  fe4_mul(&r->T, &p->X, &p->Y);
+}
+
+AVX2 static void ge4_p2_dbl(ge4_p1p1 *r, const ge4_p3 *p) {
+  fe4 t0;
+  fe4_sq(&r->X, &p->X);
+  fe4_sq(&r->Z, &p->Y);
+  fe4_sq2(&r->T, &p->Z);
+  fe4_add(&r->Y, &p->X, &p->Y);
+  fe4_sq(&t0, &r->Y);
+  fe4_add(&r->Y, &r->Z, &r->X);
+  fe4_sub(&r->Z, &r->Z, &r->X);
+  fe4_sub(&r->X, &t0, &r->Y);
+  fe4_sub(&r->T, &r->T, &r->Z);
+}
+
+AVX2 static void ge4_p3_to_cached(ge4_cached *r, const ge4_p3 *p, const fe4 *d2) {
+  fe4_add(&r->YplusX, &p->Y, &p->X);
+  fe4_sub(&r->YminusX, &p->Y, &p->X);
+  r->Z = p->Z;
+  fe4_mul(&r->T2d, &p->T, d2);
+}
+
+AVX2 static void ge4_add(ge4_p1p1 *r, const ge4_p3 *p, const ge4_cached *q) {
+  fe4 t0;
+  fe4_add(&r->X, &p->Y, &p->X);
+  fe4_sub(&r->Y, &p->Y, &p->X);
+  fe4_mul(&r->Z, &r->X, &q->YplusX);
+  fe4_mul(&r->Y, &r->Y, &q->YminusX);
+  fe4_mul(&r->T, &q->T2d, &p->T);
+  fe4_mul(&r->X, &p->Z, &q->Z);
+  fe4_add(&t0, &r->X, &r->X);
+  fe4_sub(&r->X, &r->Z, &r->Y);
+  fe4_add(&r->Y, &r->Z, &r->Y);
+  fe4_add(&r->Z, &t0, &r->T);
+  fe4_sub(&r->T, &t0, &r->T);
+}
+
+AVX2 static void ge4_madd(ge4_p1p1 *r, const ge4_p3 *p, const ge4_precomp *q) {
+  fe4 t0;
+  fe4_add(&r->X, &p->Y, &p->X);
+  fe4_sub(&r->Y, &p->Y, &p->X);
+  fe4_mul(&r->Z, &r->X, &q->yplusx);
+  fe4_mul(&r->Y, &r->Y, &q->yminusx);
+  fe4_mul(&r->T, &q->xy2d, &p->T);
+  fe4_add(&t0, &p->Z, &p->Z);
+  fe4_sub(&r->X, &r->Z, &r->Y);
+  fe4_add(&r->Y, &r->Z, &r->Y);
+  fe4_add(&r->Z, &t0, &r->T);
+  fe4_sub(&r->T, &t0, &r->T);
+}
+
+/* Negate the lanes selected by mask: swap the first two coordinates and
+ * negate the last one (xy2d or T2d, which are carried).
+ */
+AVX2 static void ge4_cneg(fe4 *plus, fe4 *minus, fe4 *last, __m256i mask) {
+  int i;
+  for (i = 0; i < 10; i++) {
+    __m256i a = plus->v[i], b = minus->v[i];
+    plus->v[i] = _mm256_blendv_epi8(a, b, mask);
+    minus->v[i] = _mm256_blendv_epi8(b, a, mask);
+    last->v[i] = _mm256_blendv_epi8(last->v[i], fe4_neg_limb(last->v[i], i), mask);
+  }
+}
+
+/* Constant time lookups. e holds a digit in -8..8 for each lane; the lane
+ * gets |e| times its point (the identity for 0), negated if e < 0.
+ */
+
+AVX2 static __m256i digits(const signed char e[4][64], int i) {
+  return _mm256_set_epi64x(e[3][i], e[2][i], e[1][i], e[0][i]);
+}
+
+AVX2 static void select_cached(ge4_cached *t, const ge4_cached Ai[8], __m256i e) {
+  const __m256i neg = _mm256_cmpgt_epi64(_mm256_setzero_si256(), e);
+  const __m256i babs = _mm256_sub_epi64(_mm256_xor_si256(e, neg), neg);
+  int i, j;
+
+  fe4_1(&t->YplusX);
+  fe4_1(&t->YminusX);
+  fe4_1(&t->Z);
+  fe4_0(&t->T2d);
+  for (j = 0; j < 8; j++) {
+    const __m256i m = _mm256_cmpeq_epi64(babs, _mm256_set1_epi64x(j + 1));
+    for (i = 0; i < 10; i++) {
+      t->YplusX.v[i] = _mm256_blendv_epi8(t->YplusX.v[i], Ai[j].YplusX.v[i], m);
+      t->YminusX.v[i] = _mm256_blendv_epi8(t->YminusX.v[i], Ai[j].YminusX.v[i], m);
+      t->Z.v[i] = _mm256_blendv_epi8(t->Z.v[i], Ai[j].Z.v[i], m);
+      t->T2d.v[i] = _mm256_blendv_epi8(t->T2d.v[i], Ai[j].T2d.v[i], m);
+    }
+  }
+  ge4_cneg(&t->YplusX, &t->YminusX, &t->T2d, neg);
+}
+
+AVX2 static void select_precomp(ge4_precomp *t, const precomp25 row[8], __m256i e) {
+  const __m256i neg = _mm256_cmpgt_epi64(_mm256_setzero_si256(), e);
+  const __m256i babs = _mm256_sub_epi64(_mm256_xor_si256(e, neg), neg);
+  int i, j;
+
+  fe4_1(&t->yplusx);
+  fe4_1(&t->yminusx);
+  fe4_0(&t->xy2d);
+  for (j = 0; j < 8; j++) {
+    const __m256i m = _mm256_cmpeq_epi64(babs, _mm256_set1_epi64x(j + 1));
+    for (i = 0; i < 10; i++) {
+      t->yplusx.v[i] = _mm256_blendv_epi8(t->yplusx.v[i], _mm256_set1_epi64x(row[j][0][i]), m);
+      t->yminusx.v[i] = _mm256_blendv_epi8(t->yminusx.v[i], _mm256_set1_epi64x(row[j][1][i]), m);
+      t->xy2d.v[i] = _mm256_blendv_epi8(t->xy2d.v[i], _mm256_set1_epi64x(row[j][2][i]), m);
+    }
+  }
+  ge4_cneg(&t->yplusx, &t->yminusx, &t->xy2d, neg);
+}
+
+/* ge_base in the limb layout above, built on first use */
+
+static precomp25 ge_base25[32][8];
+static pthread_once_t ge_base25_once = PTHREAD_ONCE_INIT;
+
+static void ge_base25_init(void) {
+  int i, j;
+  for (i = 0; i < 32; i++) {
+    for (j = 0; j < 8; j++) {
+      fe25_from_fe(ge_base25[i][j][0], ge_base[i][j].yplusx);
+      fe25_from_fe(ge_base25[i][j][1], ge_base[i][j].yminusx);
+      fe25_from_fe(ge_base25[i][j][2], ge_base[i][j].xy2d);
+    }
+  }
+}
+
+/* A, 2A, ..., 8A */
+AVX2 static void ge4_multiples(ge4_cached Ai[8], const ge4_p3 *A) {
+  ge4_p1p1 t;
+  ge4_p3 u;
+  fe4 d2;
+  int i;
+
+  fe4_const(&d2, fe_d2);
+  ge4_p3_to_cached(&Ai[0], A, &d2);
+  for (i = 0; i < 7; i++) {
+    ge4_add(&t, A, &Ai[i]);
+    ge4_p1p1_to_p3(&u, &t);
+    ge4_p3_to_cached(&Ai[i + 1], &u, &d2);
+  }
+}
+
+/* As ge_scalarmult_base, e holds the radix 16 digits of the four scalars */
+AVX2 void ge_scalarmult_base_x4(ge_p3 *r, const signed char e[4][64]) {
+  ge4_precomp t;
+  ge4_p1p1 s;
+  ge4_p3 h;
+  int i;
+
+  pthread_once(&ge_base25_once, ge_base25_init);
+
+  ge4_p3_0(&h);
+  for (i = 1; i < 64; i += 2) {
+    select_precomp(&t, ge_base25[i / 2], digits(e, i));
+    ge4_madd(&s, &h, &t); ge4_p1p1_to_p3(&h, &s);
+  }
+
+  ge4_p2_dbl(&s, &h); ge4_p1p1_to_p2(&h, &s);
+  ge4_p2_dbl(&s, &h); ge4_p1p1_to_p2(&h, &s);
+  ge4_p2_dbl(&s, &h); ge4_p1p1_to_p2(&h, &s);
+  ge4_p2_dbl(&s, &h); ge4_p1p1_to_p3(&h, &s);
+
+  for (i = 0; i < 64; i += 2) {
+    select_precomp(&t, ge_base25[i / 2], digits(e, i));
+    ge4_madd(&s, &h, &t); ge4_p1p1_to_p3(&h, &s);
+  }
+
+  ge4_p3_store(r, &h);
+}
+
+/* As ge_scalarmult_p3 */
+AVX2 void ge_scalarmult_p3_x4(ge_p3 *r, const signed char e[4][64], const ge_p3 *A) {
+  ge4_cached Ai[8], cur;
+  ge4_p1p1 t;
+  ge4_p3 a, h;
+  int i;
+
+  ge4_p3_load(&a, A);
+  ge4_multiples(Ai, &a);
+
+  ge4_p3_0(&h);
+  for (i = 63; i >= 0; i--) {
+    ge4_p2_dbl(&t, &h); ge4_p1p1_to_p2(&h, &t);
+    ge4_p2_dbl(&t, &h); ge4_p1p1_to_p2(&h, &t);
+    ge4_p2_dbl(&t, &h); ge4_p1p1_to_p2(&h, &t);
+    ge4_p2_dbl(&t, &h); ge4_p1p1_to_p3(&h, &t);
+    select_cached(&cur, Ai, digits(e, i));
+    ge4_add(&t, &h, &cur);
+    if (i == 0)
+      ge4_p1p1_to_p3(&h, &t);
+    else
+      ge4_p1p1_to_p2(&h, &t);
+  }
+
+  ge4_p3_store(r, &h);
+}
+
+/* r = a * A + b * B. Sliding windows would put the additions of the four
+ * lanes at different places, so this uses the fixed windows of the constant
+ * time code (joint, with the B part from ge_base[0]) and only skips leading
+ * zero windows.
+ */
+AVX2 void ge_double_scalarmult_base_vartime_p3_x4(ge_p3 *r, const signed char ea[4][64], const ge_p3 *A, const signed char eb[4][64]) {
+  ge4_cached Ai[8], cur;
+  ge4_precomp pre;
+  ge4_p1p1 t;
+  ge4_p3 a, h;
+  int i, k, top;
+
+  pthread_once(&ge_base25_once, ge_base25_init);
+
+  ge4_p3_load(&a, A);
+  ge4_multiples(Ai, &a);
+
+  for (top = 63; top >= 0; top--) {
+    for (k = 0; k < 4; k++) {
+      if (ea[k][top] || eb[k][top]) break;
+    }
+    if (k < 4) break;
+  }
+
+  ge4_p3_0(&h);
+  for (i = top; i >= 0; i--) {
+    ge4_p2_dbl(&t, &h); ge4_p1p1_to_p2(&h, &t);
+    ge4_p2_dbl(&t, &h); ge4_p1p1_to_p2(&h, &t);
+    ge4_p2_dbl(&t, &h); ge4_p1p1_to_p2(&h, &t);
+    ge4_p2_dbl(&t, &h); ge4_p1p1_to_p3(&h, &t);
+    select_cached(&cur, Ai, digits(ea, i));
+    ge4_add(&t, &h, &cur);
+    ge4_p1p1_to_p3(&h, &t);
+    select_precomp(&pre, ge_base25[0], digits(eb, i));
+    ge4_madd(&t, &h, &pre);
+    if (i == 0)
+      ge4_p1p1_to_p3(&h, &t);
+    else
+      ge4_p1p1_to_p2(&h, &t);
+  }
+
+  ge4_p3_store(r, &h);
+}
+
+/* out[i] = z[i]^((p-5)/8), the chain of fe_pow22523 in crypto-ops.c run on
+ * four elements at once for ge_fromfe_frombytes_vartime_batch.
+ */
+AVX2 void fe_pow22523_x4(fe out[4], const fe z[4]) {
+  fe4 z4, t0, t1, t2;
+  int i;
+
+  fe4_load(&z4, z[0], z[1], z[2], z[3]);
+  fe4_sq(&t0, &z4);
+  fe4_sq(&t1, &t0);
+  fe4_sq(&t1, &t1);
+  fe4_mul(&t1, &z4, &t1);
+  fe4_mul(&t0, &t0, &t1);
+  fe4_sq(&t0, &t0);
+  fe4_mul(&t0, &t1, &t0);
+  fe4_sq(&t1, &t0);
+  for (i = 0; i < 4; ++i) {
+    fe4_sq(&t1, &t1);
+  }
+  fe4_mul(&t0, &t1, &t0);
+  fe4_sq(&t1, &t0);
+  for (i = 0; i < 9; ++i) {
+    fe4_sq(&t1, &t1);
+  }
+  fe4_mul(&t1, &t1, &t0);
+  fe4_sq(&t2, &t1);
+  for (i = 0; i < 19; ++i) {
+    fe4_sq(&t2, &t2);
+  }
+  fe4_mul(&t1, &t2, &t1);
+  for (i = 0; i < 10; ++i) {
+    fe4_sq(&t1, &t1);
+  }
+  fe4_mul(&t0, &t1, &t0);
+  fe4_sq(&t1, &t0);
+  for (i = 0; i < 49; ++i) {
+    fe4_sq(&t1, &t1);
+  }
+  fe4_mul(&t1, &t1, &t0);
+  fe4_sq(&t2, &t1);
+  for (i = 0; i < 99; ++i) {
+    fe4_sq(&t2, &t2);
+  }
+  fe4_mul(&t1, &t2, &t1);
+  for (i = 0; i < 50; ++i) {
+    fe4_sq(&t1, &t1);
+  }
+  fe4_mul(&t0, &t1, &t0);
+  fe4_sq(&t0, &t0);
+  fe4_sq(&t0, &t0);
+  fe4_mul(&t0, &t0, &z4);
+  fe4_store(out[0], out[1], out[2], out[3], &t0);
+}
+
+#endif
@@ -0,0 +1,198 @@
+// Copyright (c) 2014-2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/* Writes crypto-ops-dataH.c: the fixed-base tables for the rangeproof
+ * amount generator H, in the limbs of the field backend this is compiled
+ * for.
+ *
+ *  ge_H[i][j] = (j + 1) * 256^i * H, laid out like ge_base
+ *  ge_H2[i]   = 2^i * H, the H2 points of rangeproofs.h
+ *
+ * Usage: crypto-ops-gentables <output file>
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "crypto-ops.h"
+#include "../rangeproofs.h"
+
+/* crypto-ops.c refers to the tables this program writes */
+const ge_precomp ge_H[32][8];
+const ge_precomp ge_H2[64];
+
+#if defined(CRYPTO_OPS_FE51)
+#define LIMBS 5
+#else
+#define LIMBS 10
+#endif
+
+/* Bits pos .. pos + w - 1 of the little-endian s */
+static uint64_t get_bits(const unsigned char *s, int pos, int w) {
+  uint64_t r = 0;
+  int i;
+
+  for (i = w - 1; i >= 0; i--) {
+    r = (r << 1) | ((s[(pos + i) >> 3] >> ((pos + i) & 7)) & 1);
+  }
+  return r;
+}
+
+/* Fully reduced limbs of f, signed and centred for ref10 as in its tables */
+static void fe_reduced(int64_t h[LIMBS], const fe f) {
+  unsigned char s[32];
+  int i;
+
+  fe_tobytes(s, f);
+#if defined(CRYPTO_OPS_FE51)
+  for (i = 0; i < LIMBS; i++) {
+    h[i] = get_bits(s, 51 * i, 51);
+  }
+#else
+  {
+    static const int pos[10] = {0, 26, 51, 77, 102, 128, 153, 179, 204, 230};
+    int64_t c;
+    for (i = 0; i < LIMBS; i++) {
+      h[i] = get_bits(s, pos[i], (i & 1) ? 25 : 26);
+    }
+    for (i = 0; i < LIMBS; i++) {
+      if (i & 1) {
+        c = (h[i] + (1 << 24)) >> 25;
+        h[i] -= c << 25;
+      } else {
+        c = (h[i] + (1 << 25)) >> 26;
+        h[i] -= c << 26;
+      }
+      if (i == LIMBS - 1) {
+        h[0] += c * 19;
+      } else {
+        h[i + 1] += c;
+      }
+    }
+  }
+#endif
+}
+
+static void print_fe(FILE *out, const fe f) {
+  int64_t h[LIMBS];
+  int i;
+
+  fe_reduced(h, f);
+  fprintf(out, "{");
+  for (i = 0; i < LIMBS; i++) {
+#if defined(CRYPTO_OPS_FE51)
+    fprintf(out, "0x%013llx", (unsigned long long) h[i]);
+#else
+    fprintf(out, "%lld", (long long) h[i]);
+#endif
+    fprintf(out, i == LIMBS - 1 ? "}" : ", ");
+  }
+}
+
+/* P as (y + x, y - x, 2dxy), going through its encoding to get Z = 1 */
+static void print_precomp(FILE *out, const ge_p3 *P, const char *indent) {
+  unsigned char s[32];
+  ge_p3 A;
+  ge_cached c;
+
+  ge_p3_tobytes(s, P);
+  ge_frombytes_vartime(&A, s);
+  ge_p3_to_cached(&c, &A);
+
+  fprintf(out, "%s{", indent);
+  print_fe(out, c.YplusX);
+  fprintf(out, ",\n%s ", indent);
+  print_fe(out, c.YminusX);
+  fprintf(out, ",\n%s ", indent);
+  print_fe(out, c.T2d);
+  fprintf(out, "}");
+}
+
+static void add(ge_p3 *r, const ge_p3 *p, const ge_p3 *q) {
+  ge_cached c;
+  ge_p1p1 t;
+
+  ge_p3_to_cached(&c, q);
+  ge_add(&t, p, &c);
+  ge_p1p1_to_p3(r, &t);
+}
+
+int main(int argc, char **argv) {
+  FILE *out;
+  ge_p3 row, P, H3;
+  ge_p2 s;
+  ge_p1p1 t;
+  int i, j;
+
+  if (argc != 2 || (out = fopen(argv[1], "w")) == NULL) {
+    fprintf(stderr, "usage: %s <output file>\n", argv[0]);
+    return 1;
+  }
+
+  fprintf(out, "/* Generated by crypto-ops-gentables.c, do not edit */\n\n");
+  fprintf(out, "#include <stdint.h>\n\n#include \"crypto-ops.h\"\n\n");
+
+  fprintf(out, "const ge_precomp ge_H[32][8] = {\n");
+  if (ge_frombytes_vartime(&row, H) != 0) {
+    fprintf(stderr, "H does not decompress\n");
+    return 1;
+  }
+  for (i = 0; i < 32; i++) {
+    fprintf(out, "  {\n");
+    P = row;
+    for (j = 0; j < 8; j++) {
+      print_precomp(out, &P, "    ");
+      fprintf(out, j == 7 ? "\n" : ",\n");
+      add(&P, &P, &row);
+    }
+    fprintf(out, i == 31 ? "  }\n" : "  },\n");
+
+    /* row = 256 * row */
+    ge_p3_to_p2(&s, &row);
+    for (j = 0; j < 7; j++) {
+      ge_p2_dbl(&t, &s);
+      ge_p1p1_to_p2(&s, &t);
+    }
+    ge_p2_dbl(&t, &s);
+    ge_p1p1_to_p3(&row, &t);
+  }
+  fprintf(out, "};\n\n");
+
+  fprintf(out, "const ge_precomp ge_H2[64] = {\n");
+  for (i = 0; i < 64; i++) {
+    if (ge_frombytes_vartime(&H3, H2[i]) != 0) {
+      fprintf(stderr, "H2[%d] does not decompress\n", i);
+      return 1;
+    }
+    print_precomp(out, &H3, "  ");
+    fprintf(out, i == 63 ? "\n" : ",\n");
+  }
+  fprintf(out, "};\n");
+
+  return fclose(out) == 0 ? 0 : 1;
+}
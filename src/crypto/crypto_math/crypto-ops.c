@@ -30,6 +30,9 @@
 
 
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "crypto-ops.h"
 
 //DISABLE_VS_WARNINGS(4146 4244)
@@ -38,9 +41,8 @@
 
 static void fe_mul(fe, const fe, const fe);
 static void fe_sq(fe, const fe);
-static void ge_madd(ge_p1p1 *, const ge_p3 *, const ge_precomp *);
-static void ge_msub(ge_p1p1 *, const ge_p3 *, const ge_precomp *);
 static void ge_p2_0(ge_p2 *);
+static void ge_p3_0(ge_p3 *);
 static void ge_p3_dbl(ge_p1p1 *, const ge_p3 *);
 static void fe_divpowm1(fe, const fe, const fe);
 
@@ -64,6 +66,8 @@ uint64_t load_4(const unsigned char *in)
   return result;
 }
 
+#if !defined(CRYPTO_OPS_FE51)
+
 /* From fe_0.c */
 
 /*
@@ -252,9 +256,12 @@ static void fe_copy(fe h, const fe f) {
   h[9] = f9;
 }
 
-/* From fe_invert.c */
+#endif
+
+/* From fe_invert.c. Always built, with CRYPTO_OPS_SAFEGCD it is what the
+ * tests compare the safegcd fe_invert against. */
 
-void fe_invert(fe out, const fe z) {
+void fe_invert_chain(fe out, const fe z) {
   fe t0;
   fe t1;
   fe t2;
@@ -312,6 +319,14 @@ void fe_invert(fe out, const fe z) {
   return;
 }
 
+#if !defined(CRYPTO_OPS_SAFEGCD)
+
+void fe_invert(fe out, const fe z) {
+  fe_invert_chain(out, z);
+}
+
+#endif
+
 /* From fe_isnegative.c */
 
 /*
@@ -339,6 +354,8 @@ static int fe_isnonzero(const fe f) {
     s[27] | s[28] | s[29] | s[30] | s[31]) - 1) >> 8) + 1;
 }
 
+#if !defined(CRYPTO_OPS_FE51)
+
 /* From fe_mul.c */
 
 /*
@@ -1119,6 +1136,459 @@ void fe_tobytes(unsigned char *s, const fe h) {
   s[31] = h9 >> 18;
 }
 
+#else
+
+/* Radix 2^51 field arithmetic.
+ *
+ * An element is h[0]+2^51*h[1]+2^102*h[2]+2^153*h[3]+2^204*h[4] with 64-bit
+ * limbs and 128-bit products, so a multiplication is 25 64x64 multiplies
+ * instead of ref10's 100 32x32 ones. Selected by crypto-ops.h whenever the
+ * compiler provides unsigned __int128; results are identical to ref10 since
+ * everything leaving the field (fe_tobytes) is fully reduced.
+ *
+ * Limbs of fe_mul/fe_sq/fe_sub/fe_neg outputs are below 2^51+2^13, fe_add
+ * does not carry. Inputs to fe_mul/fe_sq may have limbs up to 2^54, inputs
+ * to fe_sub/fe_neg up to 2^53 (the size of the 4p bias).
+ */
+
+typedef unsigned __int128 uint128_t;
+
+static const uint64_t fe51_mask = (((uint64_t) 1) << 51) - 1;
+
+static uint64_t load_8(const unsigned char *in) {
+  uint64_t result;
+  result = (uint64_t) in[0];
+  result |= ((uint64_t) in[1]) << 8;
+  result |= ((uint64_t) in[2]) << 16;
+  result |= ((uint64_t) in[3]) << 24;
+  result |= ((uint64_t) in[4]) << 32;
+  result |= ((uint64_t) in[5]) << 40;
+  result |= ((uint64_t) in[6]) << 48;
+  result |= ((uint64_t) in[7]) << 56;
+  return result;
+}
+
+static void fe_0(fe h) {
+  h[0] = 0;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+static void fe_1(fe h) {
+  h[0] = 1;
+  h[1] = 0;
+  h[2] = 0;
+  h[3] = 0;
+  h[4] = 0;
+}
+
+/*
+h = f + g
+Can overlap h with f or g.
+*/
+
+void fe_add(fe h, const fe f, const fe g) {
+  h[0] = f[0] + g[0];
+  h[1] = f[1] + g[1];
+  h[2] = f[2] + g[2];
+  h[3] = f[3] + g[3];
+  h[4] = f[4] + g[4];
+}
+
+/*
+Replace (f,g) with (g,g) if b == 1;
+replace (f,g) with (f,g) if b == 0.
+
+Preconditions: b in {0,1}.
+*/
+
+static void fe_cmov(fe f, const fe g, unsigned int b) {
+  uint64_t mask = 0 - (uint64_t) b;
+  assert((((b - 1) & ~b) | ((b - 2) & ~(b - 1))) == (unsigned int) -1);
+  f[0] ^= (f[0] ^ g[0]) & mask;
+  f[1] ^= (f[1] ^ g[1]) & mask;
+  f[2] ^= (f[2] ^ g[2]) & mask;
+  f[3] ^= (f[3] ^ g[3]) & mask;
+  f[4] ^= (f[4] ^ g[4]) & mask;
+}
+
+static void fe_copy(fe h, const fe f) {
+  h[0] = f[0];
+  h[1] = f[1];
+  h[2] = f[2];
+  h[3] = f[3];
+  h[4] = f[4];
+}
+
+/* Carry the 128-bit column sums of a product back into five 51-bit limbs */
+#define FE51_CARRY_WIDE(h, t0, t1, t2, t3, t4) do { \
+  uint64_t c_; \
+  c_ = (uint64_t) (t0 >> 51); h[0] = (uint64_t) t0 & fe51_mask; t1 += c_; \
+  c_ = (uint64_t) (t1 >> 51); h[1] = (uint64_t) t1 & fe51_mask; t2 += c_; \
+  c_ = (uint64_t) (t2 >> 51); h[2] = (uint64_t) t2 & fe51_mask; t3 += c_; \
+  c_ = (uint64_t) (t3 >> 51); h[3] = (uint64_t) t3 & fe51_mask; t4 += c_; \
+  c_ = (uint64_t) (t4 >> 51); h[4] = (uint64_t) t4 & fe51_mask; \
+  h[0] += c_ * 19; \
+  c_ = h[0] >> 51; h[0] &= fe51_mask; h[1] += c_; \
+} while (0)
+
+/*
+h = f * g
+Can overlap h with f or g.
+*/
+
+static void fe_mul(fe h, const fe f, const fe g) {
+  uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  uint64_t g1_19 = 19 * g1;
+  uint64_t g2_19 = 19 * g2;
+  uint64_t g3_19 = 19 * g3;
+  uint64_t g4_19 = 19 * g4;
+  uint128_t t0, t1, t2, t3, t4;
+
+  t0 = (uint128_t) f0 * g0 + (uint128_t) f1 * g4_19 + (uint128_t) f2 * g3_19 + (uint128_t) f3 * g2_19 + (uint128_t) f4 * g1_19;
+  t1 = (uint128_t) f0 * g1 + (uint128_t) f1 * g0 + (uint128_t) f2 * g4_19 + (uint128_t) f3 * g3_19 + (uint128_t) f4 * g2_19;
+  t2 = (uint128_t) f0 * g2 + (uint128_t) f1 * g1 + (uint128_t) f2 * g0 + (uint128_t) f3 * g4_19 + (uint128_t) f4 * g3_19;
+  t3 = (uint128_t) f0 * g3 + (uint128_t) f1 * g2 + (uint128_t) f2 * g1 + (uint128_t) f3 * g0 + (uint128_t) f4 * g4_19;
+  t4 = (uint128_t) f0 * g4 + (uint128_t) f1 * g3 + (uint128_t) f2 * g2 + (uint128_t) f3 * g1 + (uint128_t) f4 * g0;
+
+  FE51_CARRY_WIDE(h, t0, t1, t2, t3, t4);
+}
+
+/*
+h = f * f
+Can overlap h with f.
+*/
+
+static void fe_sq(fe h, const fe f) {
+  uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  uint64_t f0_2 = 2 * f0;
+  uint64_t f1_2 = 2 * f1;
+  uint64_t f2_2 = 2 * f2;
+  uint64_t f3_19 = 19 * f3;
+  uint64_t f4_19 = 19 * f4;
+  uint128_t t0, t1, t2, t3, t4;
+
+  t0 = (uint128_t) f0 * f0 + (uint128_t) f1_2 * f4_19 + (uint128_t) f2_2 * f3_19;
+  t1 = (uint128_t) f0_2 * f1 + (uint128_t) f2_2 * f4_19 + (uint128_t) f3 * f3_19;
+  t2 = (uint128_t) f0_2 * f2 + (uint128_t) f1 * f1 + (uint128_t) (2 * f3) * f4_19;
+  t3 = (uint128_t) f0_2 * f3 + (uint128_t) f1_2 * f2 + (uint128_t) f4 * f4_19;
+  t4 = (uint128_t) f0_2 * f4 + (uint128_t) f1_2 * f3 + (uint128_t) f2 * f2;
+
+  FE51_CARRY_WIDE(h, t0, t1, t2, t3, t4);
+}
+
+/*
+h = 2 * f * f
+Can overlap h with f.
+*/
+
+static void fe_sq2(fe h, const fe f) {
+  fe_sq(h, f);
+  h[0] += h[0];
+  h[1] += h[1];
+  h[2] += h[2];
+  h[3] += h[3];
+  h[4] += h[4];
+}
+
+/*
+h = f - g
+Can overlap h with f or g.
+*/
+
+static void fe_sub(fe h, const fe f, const fe g) {
+  /* 4p, so that every limb stays positive */
+  uint64_t h0 = f[0] + 0x1fffffffffffb4 - g[0];
+  uint64_t h1 = f[1] + 0x1ffffffffffffc - g[1];
+  uint64_t h2 = f[2] + 0x1ffffffffffffc - g[2];
+  uint64_t h3 = f[3] + 0x1ffffffffffffc - g[3];
+  uint64_t h4 = f[4] + 0x1ffffffffffffc - g[4];
+  uint64_t c;
+
+  c = h0 >> 51; h0 &= fe51_mask; h1 += c;
+  c = h1 >> 51; h1 &= fe51_mask; h2 += c;
+  c = h2 >> 51; h2 &= fe51_mask; h3 += c;
+  c = h3 >> 51; h3 &= fe51_mask; h4 += c;
+  c = h4 >> 51; h4 &= fe51_mask; h0 += c * 19;
+
+  h[0] = h0;
+  h[1] = h1;
+  h[2] = h2;
+  h[3] = h3;
+  h[4] = h4;
+}
+
+/*
+h = -f
+*/
+
+static void fe_neg(fe h, const fe f) {
+  fe zero;
+  fe_0(zero);
+  fe_sub(h, zero, f);
+}
+
+/*
+Writes the canonical encoding of h, 0 <= h < p
+*/
+
+void fe_tobytes(unsigned char *s, const fe h) {
+  uint64_t t[5];
+  int i;
+
+  fe_copy(t, h);
+
+#define FE51_CARRY_CHAIN() \
+  t[1] += t[0] >> 51; t[0] &= fe51_mask; \
+  t[2] += t[1] >> 51; t[1] &= fe51_mask; \
+  t[3] += t[2] >> 51; t[2] &= fe51_mask; \
+  t[4] += t[3] >> 51; t[3] &= fe51_mask;
+#define FE51_CARRY_FULL() FE51_CARRY_CHAIN() \
+  t[0] += 19 * (t[4] >> 51); t[4] &= fe51_mask;
+
+  FE51_CARRY_FULL()
+  FE51_CARRY_FULL()
+
+  /* now t is between 0 and 2^255-1, properly carried. */
+  /* case 1: between 0 and 2^255-20. case 2: between 2^255-19 and 2^255-1. */
+  t[0] += 19;
+  FE51_CARRY_FULL()
+
+  /* now between 19 and 2^255-1 in both cases, and offset by 19. */
+  t[0] += (fe51_mask + 1) - 19;
+  t[1] += (fe51_mask + 1) - 1;
+  t[2] += (fe51_mask + 1) - 1;
+  t[3] += (fe51_mask + 1) - 1;
+  t[4] += (fe51_mask + 1) - 1;
+
+  /* now between 2^255 and 2^256-20, and offset by 2^255. */
+  FE51_CARRY_CHAIN()
+  t[4] &= fe51_mask;
+
+#undef FE51_CARRY_FULL
+#undef FE51_CARRY_CHAIN
+
+  for (i = 0; i < 7; i++) {
+    s[i] = t[0] >> (8 * i);
+  }
+  s[6] |= t[1] << 3;
+  for (i = 0; i < 6; i++) {
+    s[7 + i] = t[1] >> (5 + 8 * i);
+  }
+  s[12] |= t[2] << 6;
+  for (i = 0; i < 7; i++) {
+    s[13 + i] = t[2] >> (2 + 8 * i);
+  }
+  s[19] |= t[3] << 1;
+  for (i = 0; i < 6; i++) {
+    s[20 + i] = t[3] >> (7 + 8 * i);
+  }
+  s[25] |= t[4] << 4;
+  for (i = 0; i < 6; i++) {
+    s[26 + i] = t[4] >> (4 + 8 * i);
+  }
+}
+
+/*
+Loads the low 255 bits of s
+*/
+
+static void fe_frombytes(fe h, const unsigned char *s) {
+  h[0] = load_8(s) & fe51_mask;
+  h[1] = (load_8(s + 6) >> 3) & fe51_mask;
+  h[2] = (load_8(s + 12) >> 6) & fe51_mask;
+  h[3] = (load_8(s + 19) >> 1) & fe51_mask;
+  h[4] = (load_8(s + 24) >> 12) & fe51_mask;
+}
+
+#if defined(CRYPTO_OPS_SAFEGCD)
+
+/* Constant time inversion by the safegcd algorithm of Bernstein and Yang,
+ * "Fast constant-time gcd computation and modular inversion" (2019), as
+ * libsecp256k1's modinv64 does it: 10 rounds of 59 divsteps each on signed
+ * 62-bit limbs, every round folded into a 2x2 transition matrix (scaled by
+ * 2^62) that is then applied to f, g and to the Bezout coefficients d, e.
+ * 590 divsteps are enough for any 256-bit modulus.
+ */
+
+typedef struct {
+  int64_t v[5];
+} fe62;
+
+static const uint64_t fe62_mask = (((uint64_t) 1) << 62) - 1;
+
+/* p = -19 + 128 * 2^248 and 1/p mod 2^62 */
+static const fe62 fe62_p = {{ -19, 0, 0, 0, 128 }};
+static const uint64_t fe62_pinv = 0x39435e50d79435e5ULL;
+
+static int64_t fe62_divsteps_59(int64_t zeta, uint64_t f0, uint64_t g0, int64_t t[4]) {
+  /* The matrix u v / q r starts as 8 times the identity and is doubled 59
+   * times. Its entries are in [-2^62, 2^62], kept as unsigned so the shifts
+   * are defined.
+   */
+  uint64_t u = 8, v = 0, q = 0, r = 8;
+  volatile uint64_t c1, c2;
+  uint64_t mask1, mask2, f = f0, g = g0, x, y, z;
+  int i;
+
+  for (i = 3; i < 62; ++i) {
+    /* zeta = -(delta + 1/2); masks for zeta < 0 and for g odd */
+    c1 = zeta >> 63;
+    mask1 = c1;
+    c2 = g & 1;
+    mask2 = -c2;
+    x = (f ^ mask1) - mask1;
+    y = (u ^ mask1) - mask1;
+    z = (v ^ mask1) - mask1;
+    g += x & mask2;
+    q += y & mask2;
+    r += z & mask2;
+    mask1 &= mask2;
+    zeta = (zeta ^ (int64_t) mask1) - 1;
+    f += g & mask1;
+    u += q & mask1;
+    v += r & mask1;
+    g >>= 1;
+    u <<= 1;
+    v <<= 1;
+  }
+  t[0] = (int64_t) u;
+  t[1] = (int64_t) v;
+  t[2] = (int64_t) q;
+  t[3] = (int64_t) r;
+  return zeta;
+}
+
+/* [d, e] = t [d, e] / 2^62 mod p, adding the multiple of p that makes the
+ * division exact. d and e stay in (-2p, p).
+ */
+static void fe62_update_de(fe62 *d, fe62 *e, const int64_t t[4]) {
+  const int64_t u = t[0], v = t[1], q = t[2], r = t[3];
+  int64_t sd = d->v[4] >> 63, se = e->v[4] >> 63;
+  int64_t md = (u & sd) + (v & se);
+  int64_t me = (q & sd) + (r & se);
+  __int128 cd, ce;
+  int i;
+
+  cd = (__int128) u * d->v[0] + (__int128) v * e->v[0];
+  ce = (__int128) q * d->v[0] + (__int128) r * e->v[0];
+  md -= (fe62_pinv * (uint64_t) cd + md) & fe62_mask;
+  me -= (fe62_pinv * (uint64_t) ce + me) & fe62_mask;
+  cd += (__int128) fe62_p.v[0] * md;
+  ce += (__int128) fe62_p.v[0] * me;
+  cd >>= 62;
+  ce >>= 62;
+  /* Limbs 1 to 3 of p are zero */
+  for (i = 1; i < 4; i++) {
+    cd += (__int128) u * d->v[i] + (__int128) v * e->v[i];
+    ce += (__int128) q * d->v[i] + (__int128) r * e->v[i];
+    d->v[i - 1] = (int64_t) cd & fe62_mask; cd >>= 62;
+    e->v[i - 1] = (int64_t) ce & fe62_mask; ce >>= 62;
+  }
+  cd += (__int128) u * d->v[4] + (__int128) v * e->v[4];
+  ce += (__int128) q * d->v[4] + (__int128) r * e->v[4];
+  cd += (__int128) fe62_p.v[4] * md;
+  ce += (__int128) fe62_p.v[4] * me;
+  d->v[3] = (int64_t) cd & fe62_mask; cd >>= 62;
+  e->v[3] = (int64_t) ce & fe62_mask; ce >>= 62;
+  d->v[4] = (int64_t) cd;
+  e->v[4] = (int64_t) ce;
+}
+
+/* [f, g] = t [f, g] / 2^62, which is exact */
+static void fe62_update_fg(fe62 *f, fe62 *g, const int64_t t[4]) {
+  const int64_t u = t[0], v = t[1], q = t[2], r = t[3];
+  __int128 cf, cg;
+  int i;
+
+  cf = (__int128) u * f->v[0] + (__int128) v * g->v[0];
+  cg = (__int128) q * f->v[0] + (__int128) r * g->v[0];
+  cf >>= 62;
+  cg >>= 62;
+  for (i = 1; i < 5; i++) {
+    cf += (__int128) u * f->v[i] + (__int128) v * g->v[i];
+    cg += (__int128) q * f->v[i] + (__int128) r * g->v[i];
+    f->v[i - 1] = (int64_t) cf & fe62_mask; cf >>= 62;
+    g->v[i - 1] = (int64_t) cg & fe62_mask; cg >>= 62;
+  }
+  f->v[4] = (int64_t) cf;
+  g->v[4] = (int64_t) cg;
+}
+
+/* Brings r from (-2p, p) to [0, p), negated first if sign < 0 */
+static void fe62_normalize(fe62 *r, int64_t sign) {
+  volatile int64_t cond_add, cond_negate;
+  int i;
+
+  cond_add = r->v[4] >> 63;
+  for (i = 0; i < 5; i++) {
+    r->v[i] += fe62_p.v[i] & cond_add;
+  }
+  cond_negate = sign >> 63;
+  for (i = 0; i < 5; i++) {
+    r->v[i] = (r->v[i] ^ cond_negate) - cond_negate;
+  }
+  for (i = 0; i < 4; i++) {
+    r->v[i + 1] += r->v[i] >> 62;
+    r->v[i] &= fe62_mask;
+  }
+
+  cond_add = r->v[4] >> 63;
+  for (i = 0; i < 5; i++) {
+    r->v[i] += fe62_p.v[i] & cond_add;
+  }
+  for (i = 0; i < 4; i++) {
+    r->v[i + 1] += r->v[i] >> 62;
+    r->v[i] &= fe62_mask;
+  }
+}
+
+void fe_invert(fe out, const fe z) {
+  fe62 d = {{ 0, 0, 0, 0, 0 }}, e = {{ 1, 0, 0, 0, 0 }}, f = fe62_p, g;
+  int64_t zeta = -1, t[4];
+  uint64_t a0, a1, a2, a3;
+  unsigned char s[32];
+  int i;
+
+  fe_tobytes(s, z);
+  a0 = load_8(s);
+  a1 = load_8(s + 8);
+  a2 = load_8(s + 16);
+  a3 = load_8(s + 24);
+  g.v[0] = a0 & fe62_mask;
+  g.v[1] = ((a0 >> 62) | (a1 << 2)) & fe62_mask;
+  g.v[2] = ((a1 >> 60) | (a2 << 4)) & fe62_mask;
+  g.v[3] = ((a2 >> 58) | (a3 << 6)) & fe62_mask;
+  g.v[4] = a3 >> 56;
+
+  for (i = 0; i < 10; i++) {
+    zeta = fe62_divsteps_59(zeta, f.v[0], g.v[0], t);
+    fe62_update_de(&d, &e, t);
+    fe62_update_fg(&f, &g, t);
+  }
+  /* g is now 0 and f = +-1, so d = +-1/z */
+  fe62_normalize(&d, f.v[4]);
+
+  a0 = (uint64_t) d.v[0] | ((uint64_t) d.v[1] << 62);
+  a1 = ((uint64_t) d.v[1] >> 2) | ((uint64_t) d.v[2] << 60);
+  a2 = ((uint64_t) d.v[2] >> 4) | ((uint64_t) d.v[3] << 58);
+  a3 = ((uint64_t) d.v[3] >> 6) | ((uint64_t) d.v[4] << 56);
+  for (i = 0; i < 8; i++) {
+    s[i] = a0 >> (8 * i);
+    s[i + 8] = a1 >> (8 * i);
+    s[i + 16] = a2 >> (8 * i);
+    s[i + 24] = a3 >> (8 * i);
+  }
+  fe_frombytes(out, s);
+}
+
+#endif
+
+#endif
+
 /* From ge_add.c */
 
 void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
@@ -1170,6 +1640,47 @@ static void slide(signed char *r, const unsigned char *a) {
   }
 }
 
+/* The G half of the vartime double scalar multiplications: ge_Bi with
+ * width 5, or the wider table set by ge_double_scalarmult_base_init.
+ */
+static const ge_precomp *ge_Bi_table = ge_Bi;
+static ge_precomp *ge_Bi_wide = NULL;
+static int ge_Bi_w = 5;
+
+/* slide with odd digits below 2^(w-1), so slide_wide(r, a, 5) matches it */
+static void slide_wide(short *r, const unsigned char *a, int w) {
+  int limit = (1 << (w - 1)) - 1;
+  int i;
+  int b;
+  int k;
+
+  for (i = 0; i < 256; ++i) {
+    r[i] = 1 & (a[i >> 3] >> (i & 7));
+  }
+
+  for (i = 0; i < 256; ++i) {
+    if (r[i]) {
+      for (b = 1; b <= w + 1 && i + b < 256; ++b) {
+        if (r[i + b]) {
+          if (r[i] + (r[i + b] << b) <= limit) {
+            r[i] += r[i + b] << b; r[i + b] = 0;
+          } else if (r[i] - (r[i + b] << b) >= -limit) {
+            r[i] -= r[i + b] << b;
+            for (k = i + b; k < 256; ++k) {
+              if (!r[k]) {
+                r[k] = 1;
+                break;
+              }
+              r[k] = 0;
+            }
+          } else
+            break;
+        }
+      }
+    }
+  }
+}
+
 void ge_dsm_precomp(ge_dsmp r, const ge_p3 *s) {
   ge_p1p1 t;
   ge_p3 s2, u;
@@ -1193,14 +1704,15 @@ B is the Ed25519 base point (x,4/5) with x positive.
 
 void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
   signed char aslide[256];
-  signed char bslide[256];
+  short bslide[256];
+  const ge_precomp *Bi = ge_Bi_table;
   ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
   ge_p1p1 t;
   ge_p3 u;
   int i;
 
   slide(aslide, a);
-  slide(bslide, b);
+  slide_wide(bslide, b, ge_Bi_w);
   ge_dsm_precomp(Ai, A);
 
   ge_p2_0(r);
@@ -1222,10 +1734,10 @@ void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const g
 
     if (bslide[i] > 0) {
       ge_p1p1_to_p3(&u, &t);
-      ge_madd(&t, &u, &ge_Bi[bslide[i]/2]);
+      ge_madd(&t, &u, &Bi[bslide[i]/2]);
     } else if (bslide[i] < 0) {
       ge_p1p1_to_p3(&u, &t);
-      ge_msub(&t, &u, &ge_Bi[(-bslide[i])/2]);
+      ge_msub(&t, &u, &Bi[(-bslide[i])/2]);
     }
 
     ge_p1p1_to_p2(r, &t);
@@ -1233,17 +1745,24 @@ void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const g
 }
 
 void ge_double_scalarmult_base_vartime_p3(ge_p3 *r3, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
-  signed char aslide[256];
-  signed char bslide[256];
   ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+
+  ge_dsm_precomp(Ai, A);
+  ge_double_scalarmult_base_precomp_vartime_p3(r3, a, Ai, b);
+}
+
+/* As above, with the table of A built by the caller */
+void ge_double_scalarmult_base_precomp_vartime_p3(ge_p3 *r3, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b) {
+  signed char aslide[256];
+  short bslide[256];
+  const ge_precomp *Bi = ge_Bi_table;
   ge_p1p1 t;
   ge_p3 u;
   ge_p2 r;
   int i;
 
   slide(aslide, a);
-  slide(bslide, b);
-  ge_dsm_precomp(Ai, A);
+  slide_wide(bslide, b, ge_Bi_w);
 
   ge_p2_0(&r);
 
@@ -1251,6 +1770,11 @@ void ge_double_scalarmult_base_vartime_p3(ge_p3 *r3, const unsigned char *a, con
     if (aslide[i] || bslide[i]) break;
   }
 
+  if (i < 0) {
+    ge_p3_0(r3);
+    return;
+  }
+
   for (; i >= 0; --i) {
     ge_p2_dbl(&t, &r);
 
@@ -1264,10 +1788,10 @@ void ge_double_scalarmult_base_vartime_p3(ge_p3 *r3, const unsigned char *a, con
 
     if (bslide[i] > 0) {
       ge_p1p1_to_p3(&u, &t);
-      ge_madd(&t, &u, &ge_Bi[bslide[i]/2]);
+      ge_madd(&t, &u, &Bi[bslide[i]/2]);
     } else if (bslide[i] < 0) {
       ge_p1p1_to_p3(&u, &t);
-      ge_msub(&t, &u, &ge_Bi[(-bslide[i])/2]);
+      ge_msub(&t, &u, &Bi[(-bslide[i])/2]);
     }
 
     if (i == 0)
@@ -1285,6 +1809,20 @@ int ge_frombytes_vartime(ge_p3 *h, const unsigned char *s) {
   fe vxx;
   fe check;
 
+#if defined(CRYPTO_OPS_FE51)
+  /* Validate the number to be canonical */
+  {
+    unsigned char c = s[31] & 0x7f;
+    int i;
+    for (i = 30; i > 0; --i) {
+      c &= s[i];
+    }
+    if (c == 0x7f && s[0] >= 0xed) {
+      return -1;
+    }
+  }
+  fe_frombytes(h->Y, s);
+#else
   /* From fe_frombytes.c */
 
   int64_t h0 = load_4(s);
@@ -1339,6 +1877,7 @@ int ge_frombytes_vartime(ge_p3 *h, const unsigned char *s) {
   h->Y[9] = h9;
 
   /* End fe_frombytes.c */
+#endif
 
   fe_1(h->Z);
   fe_sq(u, h->Y);
@@ -1377,7 +1916,7 @@ int ge_frombytes_vartime(ge_p3 *h, const unsigned char *s) {
 r = p + q
 */
 
-static void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
+void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
   fe t0;
   fe_add(r->X, p->Y, p->X);
   fe_sub(r->Y, p->Y, p->X);
@@ -1397,7 +1936,7 @@ static void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
 r = p - q
 */
 
-static void ge_msub(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
+void ge_msub(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
   fe t0;
   fe_add(r->X, p->Y, p->X);
   fe_sub(r->Y, p->Y, p->X);
@@ -1523,6 +2062,45 @@ void ge_p3_tobytes(unsigned char *s, const ge_p3 *h) {
   s[31] ^= fe_isnegative(x) << 7;
 }
 
+/* Compress n points with one inversion per GE_TOBYTES_BATCH of them
+ * (Montgomery's trick): the running products of the Z are inverted once and
+ * the single inverses recovered on the way back.
+ */
+
+#define GE_TOBYTES_BATCH 64
+
+void ge_p3_tobytes_batch(unsigned char (*s)[32], const ge_p3 *h, size_t n) {
+  fe acc[GE_TOBYTES_BATCH];
+  fe inv;
+  fe recip;
+  fe x;
+  fe y;
+  size_t i, j, m;
+
+  for (i = 0; i < n; i += m) {
+    m = n - i < GE_TOBYTES_BATCH ? n - i : GE_TOBYTES_BATCH;
+
+    fe_copy(acc[0], h[i].Z);
+    for (j = 1; j < m; j++) {
+      fe_mul(acc[j], acc[j - 1], h[i + j].Z);
+    }
+    fe_invert(inv, acc[m - 1]);
+
+    for (j = m - 1; j > 0; j--) {
+      fe_mul(recip, inv, acc[j - 1]);  /* 1/Z_j */
+      fe_mul(inv, inv, h[i + j].Z);    /* 1/(Z_0...Z_{j-1}) */
+      fe_mul(x, h[i + j].X, recip);
+      fe_mul(y, h[i + j].Y, recip);
+      fe_tobytes(s[i + j], y);
+      s[i + j][31] ^= fe_isnegative(x) << 7;
+    }
+    fe_mul(x, h[i].X, inv);
+    fe_mul(y, h[i].Y, inv);
+    fe_tobytes(s[i], y);
+    s[i][31] ^= fe_isnegative(x) << 7;
+  }
+}
+
 /* From ge_precomp_0.c */
 
 static void ge_precomp_0(ge_precomp *h) {
@@ -1555,20 +2133,20 @@ static void ge_precomp_cmov(ge_precomp *t, const ge_precomp *u, unsigned char b)
   fe_cmov(t->xy2d, u->xy2d, b);
 }
 
-static void select(ge_precomp *t, int pos, signed char b) {
+static void ge_precomp_select(ge_precomp *t, const ge_precomp *row, signed char b) {
   ge_precomp minust;
   unsigned char bnegative = negative(b);
   unsigned char babs = b - (((-bnegative) & b) << 1);
 
   ge_precomp_0(t);
-  ge_precomp_cmov(t, &ge_base[pos][0], equal(babs, 1));
-  ge_precomp_cmov(t, &ge_base[pos][1], equal(babs, 2));
-  ge_precomp_cmov(t, &ge_base[pos][2], equal(babs, 3));
-  ge_precomp_cmov(t, &ge_base[pos][3], equal(babs, 4));
-  ge_precomp_cmov(t, &ge_base[pos][4], equal(babs, 5));
-  ge_precomp_cmov(t, &ge_base[pos][5], equal(babs, 6));
-  ge_precomp_cmov(t, &ge_base[pos][6], equal(babs, 7));
-  ge_precomp_cmov(t, &ge_base[pos][7], equal(babs, 8));
+  ge_precomp_cmov(t, &row[0], equal(babs, 1));
+  ge_precomp_cmov(t, &row[1], equal(babs, 2));
+  ge_precomp_cmov(t, &row[2], equal(babs, 3));
+  ge_precomp_cmov(t, &row[3], equal(babs, 4));
+  ge_precomp_cmov(t, &row[4], equal(babs, 5));
+  ge_precomp_cmov(t, &row[5], equal(babs, 6));
+  ge_precomp_cmov(t, &row[6], equal(babs, 7));
+  ge_precomp_cmov(t, &row[7], equal(babs, 8));
   fe_copy(minust.yplusx, t->yminusx);
   fe_copy(minust.yminusx, t->yplusx);
   fe_neg(minust.xy2d, t->xy2d);
@@ -1576,42 +2154,46 @@ static void select(ge_precomp *t, int pos, signed char b) {
 }
 
 /*
-h = a * B
-where a = a[0]+256*a[1]+...+256^31 a[31]
-B is the Ed25519 base point (x,4/5) with x positive.
+h = a * P for a fixed point P with table[i][j] = (j + 1) * 256^i * P,
+where a = a[0]+256*a[1]+...+256^(len-1) a[len-1].
 
 Preconditions:
-  a[31] <= 127
+  a[31] <= 127 when len == 32
 */
 
-void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
+static void ge_scalarmult_fixed(ge_p3 *h, const unsigned char *a, int len, const ge_precomp (*table)[8]) {
   signed char e[64];
   signed char carry;
   ge_p1p1 r;
   ge_p2 s;
   ge_precomp t;
-  int i;
+  int i, n;
 
-  for (i = 0; i < 32; ++i) {
+  /* one more digit than the nibbles of a takes the last carry, except for
+   * full scalars where a[31] <= 127 leaves room in e[63] */
+  n = len < 32 ? 2 * len + 1 : 64;
+  for (i = 0; i < len; ++i) {
     e[2 * i + 0] = (a[i] >> 0) & 15;
     e[2 * i + 1] = (a[i] >> 4) & 15;
   }
+  for (i = 2 * len; i < n; ++i) {
+    e[i] = 0;
+  }
   /* each e[i] is between 0 and 15 */
-  /* e[63] is between 0 and 7 */
 
   carry = 0;
-  for (i = 0; i < 63; ++i) {
+  for (i = 0; i < n - 1; ++i) {
     e[i] += carry;
     carry = e[i] + 8;
     carry >>= 4;
     e[i] -= carry << 4;
   }
-  e[63] += carry;
+  e[n - 1] += carry;
   /* each e[i] is between -8 and 8 */
 
   ge_p3_0(h);
-  for (i = 1; i < 64; i += 2) {
-    select(&t, i / 2, e[i]);
+  for (i = 1; i < n; i += 2) {
+    ge_precomp_select(&t, table[i / 2], e[i]);
     ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
   }
 
@@ -1620,12 +2202,319 @@ void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
   ge_p2_dbl(&r, &s); ge_p1p1_to_p2(&s, &r);
   ge_p2_dbl(&r, &s); ge_p1p1_to_p3(h, &r);
 
-  for (i = 0; i < 64; i += 2) {
-    select(&t, i / 2, e[i]);
+  for (i = 0; i < n; i += 2) {
+    ge_precomp_select(&t, table[i / 2], e[i]);
     ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
   }
 }
 
+/* Wider fixed-base tables for ge_scalarmult_base, see ge_scalarmult_base_init.
+ *
+ * With window w the scalar is recoded into ceil(256 / w) signed digits of at
+ * most 2^(w-1) and row r of the table holds (j + 1) * 2^(2wr) * B for
+ * j < 2^(w-1). As with ge_base, the odd digits are added first and moved
+ * into place with w doublings, so a table has half a row per digit. Every
+ * lookup still scans the whole row, so the rows get slower as fast as the
+ * additions get fewer; tests/bench shows where that balances.
+ */
+
+#define GE_WIDE_MIN 4
+#define GE_WIDE_MAX 12
+#define GE_WIDE_DIGITS(w) ((256 + (w) - 1) / (w))
+#define GE_WIDE_ROWS(w) ((GE_WIDE_DIGITS(w) + 1) / 2)
+
+static ge_precomp *ge_base_wide = NULL;
+static int ge_base_wide_w = 0;
+
+static unsigned char equal_wide(uint32_t b, uint32_t c) {
+  uint32_t y = b ^ c; /* 0: yes; 1..2^12: no */
+  y -= 1; /* 4294967295: yes; 0..2^12: no */
+  y >>= 31; /* 1: yes; 0: no */
+  return y;
+}
+
+static void ge_precomp_select_wide(ge_precomp *t, const ge_precomp *row, int m, int b) {
+  ge_precomp minust;
+  uint32_t bnegative = (uint32_t) b >> 31;
+  uint32_t babs = (uint32_t) ((b ^ -(int) bnegative) + (int) bnegative);
+  int j;
+
+  ge_precomp_0(t);
+  for (j = 0; j < m; j++) {
+    ge_precomp_cmov(t, &row[j], equal_wide(babs, j + 1));
+  }
+  fe_copy(minust.yplusx, t->yminusx);
+  fe_copy(minust.yminusx, t->yplusx);
+  fe_neg(minust.xy2d, t->xy2d);
+  ge_precomp_cmov(t, &minust, bnegative);
+}
+
+static void ge_scalarmult_wide(ge_p3 *h, const unsigned char *a, const ge_precomp *table, int w) {
+  int e[GE_WIDE_DIGITS(GE_WIDE_MIN)];
+  int n = GE_WIDE_DIGITS(w);
+  int m = 1 << (w - 1);
+  int carry, i, k, pos;
+  uint32_t v;
+  ge_p1p1 r;
+  ge_p2 s;
+  ge_precomp t;
+
+  carry = 0;
+  for (i = 0; i < n; i++) {
+    pos = i * w;
+    v = a[pos >> 3];
+    if ((pos >> 3) + 1 < 32) v |= (uint32_t) a[(pos >> 3) + 1] << 8;
+    if ((pos >> 3) + 2 < 32) v |= (uint32_t) a[(pos >> 3) + 2] << 16;
+    e[i] = ((v >> (pos & 7)) & ((1u << w) - 1)) + carry;
+    if (i < n - 1) {
+      carry = (e[i] + m) >> w;
+      e[i] -= carry << w;
+    }
+  }
+  /* each e[i] is between -2^(w-1) and 2^(w-1) */
+
+  ge_p3_0(h);
+  for (i = 1; i < n; i += 2) {
+    ge_precomp_select_wide(&t, &table[(i / 2) * m], m, e[i]);
+    ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
+  }
+
+  ge_p3_dbl(&r, h);
+  for (k = 1; k < w; k++) {
+    ge_p1p1_to_p2(&s, &r);
+    ge_p2_dbl(&r, &s);
+  }
+  ge_p1p1_to_p3(h, &r);
+
+  for (i = 0; i < n; i += 2) {
+    ge_precomp_select_wide(&t, &table[(i / 2) * m], m, e[i]);
+    ge_madd(&r, h, &t); ge_p1p1_to_p3(h, &r);
+  }
+}
+
+/* table[i] = p[i] as ge_precomp, converting all to affine with a single
+ * inversion */
+static int ge_precomp_from_p3_batch(ge_precomp *table, const ge_p3 *p, size_t count) {
+  fe *acc = malloc(count * sizeof(fe));
+  fe inv, recip, x, y;
+  size_t i;
+
+  if (acc == NULL) {
+    return -1;
+  }
+  fe_copy(acc[0], p[0].Z);
+  for (i = 1; i < count; i++) {
+    fe_mul(acc[i], acc[i - 1], p[i].Z);
+  }
+  fe_invert(inv, acc[count - 1]);
+  for (i = count; i-- > 0;) {
+    if (i > 0) {
+      fe_mul(recip, inv, acc[i - 1]);
+      fe_mul(inv, inv, p[i].Z);
+    } else {
+      fe_copy(recip, inv);
+    }
+    fe_mul(x, p[i].X, recip);
+    fe_mul(y, p[i].Y, recip);
+    fe_add(table[i].yplusx, y, x);
+    fe_sub(table[i].yminusx, y, x);
+    fe_mul(table[i].xy2d, x, y);
+    fe_mul(table[i].xy2d, table[i].xy2d, fe_d2);
+  }
+  free(acc);
+  return 0;
+}
+
+/* Fill a table for window w */
+static int ge_base_wide_generate(ge_precomp *table, int w) {
+  static const unsigned char one[32] = {1};
+  int m = 1 << (w - 1);
+  size_t count = (size_t) GE_WIDE_ROWS(w) * m;
+  ge_p3 *p = malloc(count * sizeof(ge_p3));
+  ge_p3 row;
+  ge_cached c;
+  ge_p1p1 t;
+  ge_p2 s;
+  size_t i, j;
+  int k, res;
+
+  if (p == NULL) {
+    return -1;
+  }
+
+  ge_scalarmult_fixed(&row, one, 32, ge_base);
+  for (i = 0; i < count; i += m) {
+    p[i] = row;
+    ge_p3_to_cached(&c, &row);
+    for (j = 1; j < (size_t) m; j++) {
+      ge_add(&t, &p[i + j - 1], &c);
+      ge_p1p1_to_p3(&p[i + j], &t);
+    }
+    /* row = 2^(2w) * row */
+    ge_p3_to_p2(&s, &row);
+    for (k = 1; k < 2 * w; k++) {
+      ge_p2_dbl(&t, &s);
+      ge_p1p1_to_p2(&s, &t);
+    }
+    ge_p2_dbl(&t, &s);
+    ge_p1p1_to_p3(&row, &t);
+  }
+
+  res = ge_precomp_from_p3_batch(table, p, count);
+  free(p);
+  return res;
+}
+
+int ge_scalarmult_base_init(int window) {
+  ge_precomp *table, *old;
+  size_t count;
+
+  if (window == 0) {
+    old = ge_base_wide;
+    ge_base_wide = NULL;
+    ge_base_wide_w = 0;
+    free(old);
+    return 0;
+  }
+  if (window < GE_WIDE_MIN || window > GE_WIDE_MAX) {
+    return -1;
+  }
+
+  count = (size_t) GE_WIDE_ROWS(window) << (window - 1);
+  table = malloc(count * sizeof(ge_precomp));
+  if (table == NULL) {
+    return -1;
+  }
+  if (ge_base_wide_generate(table, window) != 0) {
+    free(table);
+    return -1;
+  }
+
+  old = ge_base_wide;
+  ge_base_wide = NULL;
+  ge_base_wide_w = window;
+  ge_base_wide = table;
+  free(old);
+  return 0;
+}
+
+size_t ge_scalarmult_base_table_size(int window) {
+  if (window == 0) {
+    return sizeof(ge_base);
+  }
+  if (window < GE_WIDE_MIN || window > GE_WIDE_MAX) {
+    return 0;
+  }
+  return ((size_t) GE_WIDE_ROWS(window) << (window - 1)) * sizeof(ge_precomp);
+}
+
+/* Odd multiples B, 3B, ..., (2^(w-1) - 1)B for the vartime functions, see
+ * ge_double_scalarmult_base_init */
+
+#define GE_BI_MIN 5
+#define GE_BI_MAX 14
+
+int ge_double_scalarmult_base_init(int window) {
+  static const unsigned char one[32] = {1};
+  ge_precomp *table, *old;
+  size_t count, i;
+  ge_p3 *p, b2;
+  ge_cached c;
+  ge_p1p1 t;
+
+  if (window == 0 || window == GE_BI_MIN) {
+    old = ge_Bi_wide;
+    ge_Bi_table = ge_Bi;
+    ge_Bi_w = GE_BI_MIN;
+    ge_Bi_wide = NULL;
+    free(old);
+    return 0;
+  }
+  if (window < GE_BI_MIN || window > GE_BI_MAX) {
+    return -1;
+  }
+
+  count = ge_double_scalarmult_base_table_size(window) / sizeof(ge_precomp);
+  table = malloc(count * sizeof(ge_precomp));
+  p = malloc(count * sizeof(ge_p3));
+  if (table == NULL || p == NULL) {
+    free(table);
+    free(p);
+    return -1;
+  }
+  ge_scalarmult_fixed(&p[0], one, 32, ge_base);
+  ge_p3_dbl(&t, &p[0]);
+  ge_p1p1_to_p3(&b2, &t);
+  ge_p3_to_cached(&c, &b2);
+  for (i = 1; i < count; i++) {
+    ge_add(&t, &p[i - 1], &c);
+    ge_p1p1_to_p3(&p[i], &t);
+  }
+  if (ge_precomp_from_p3_batch(table, p, count) != 0) {
+    free(table);
+    free(p);
+    return -1;
+  }
+  free(p);
+
+  old = ge_Bi_wide;
+  ge_Bi_table = table;
+  ge_Bi_w = window;
+  ge_Bi_wide = table;
+  free(old);
+  return 0;
+}
+
+size_t ge_double_scalarmult_base_table_size(int window) {
+  if (window == 0) {
+    window = GE_BI_MIN;
+  }
+  if (window < GE_BI_MIN || window > GE_BI_MAX) {
+    return 0;
+  }
+  return ((size_t) 1 << (window - 2)) * sizeof(ge_precomp);
+}
+
+/*
+h = a * B
+where a = a[0]+256*a[1]+...+256^31 a[31]
+B is the Ed25519 base point (x,4/5) with x positive.
+
+Preconditions:
+  a[31] <= 127
+*/
+
+void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
+  if (ge_base_wide != NULL) {
+    ge_scalarmult_wide(h, a, ge_base_wide, ge_base_wide_w);
+    return;
+  }
+  ge_scalarmult_fixed(h, a, 32, ge_base);
+}
+
+/*
+h = a * H, H the amount generator of rangeproofs.h, from the generated ge_H
+table. Same preconditions as ge_scalarmult_base.
+*/
+
+void ge_scalarmult_H(ge_p3 *h, const unsigned char *a) {
+  ge_scalarmult_fixed(h, a, 32, ge_H);
+}
+
+/*
+h = amount * H, only going through the 17 table rows a 64-bit amount needs
+*/
+
+void ge_scalarmult_H_amount(ge_p3 *h, uint64_t amount) {
+  unsigned char a[8];
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    a[i] = amount >> (8 * i);
+  }
+  ge_scalarmult_fixed(h, a, 8, ge_H);
+}
+
 /* From ge_sub.c */
 
 /*
@@ -1663,6 +2552,8 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h) {
 
 /* From sc_reduce.c */
 
+#if !defined(CRYPTO_OPS_SC64)
+
 /*
 Input:
   s[0]+256*s[1]+...+256^63*s[63] = s
@@ -1902,26 +2793,20 @@ void sc_reduce(unsigned char *s) {
   s[31] = s11 >> 17;
 }
 
-/* New code */
-
-static void fe_divpowm1(fe r, const fe u, const fe v) {
-  fe v3, uv7, t0, t1, t2;
-  int i;
+#endif
 
-  fe_sq(v3, v);
-  fe_mul(v3, v3, v); /* v3 = v^3 */
-  fe_sq(uv7, v3);
-  fe_mul(uv7, uv7, v);
-  fe_mul(uv7, uv7, u); /* uv7 = uv^7 */
+/* New code */
 
-  /*fe_pow22523(uv7, uv7);*/
+/* From fe_pow22523.c */
 
-  /* From fe_pow22523.c */
+static void fe_pow22523(fe out, const fe z) {
+  fe t0, t1, t2;
+  int i;
 
-  fe_sq(t0, uv7);
+  fe_sq(t0, z);
   fe_sq(t1, t0);
   fe_sq(t1, t1);
-  fe_mul(t1, uv7, t1);
+  fe_mul(t1, z, t1);
   fe_mul(t0, t0, t1);
   fe_sq(t0, t0);
   fe_mul(t0, t1, t0);
@@ -1960,10 +2845,25 @@ static void fe_divpowm1(fe r, const fe u, const fe v) {
   fe_mul(t0, t1, t0);
   fe_sq(t0, t0);
   fe_sq(t0, t0);
-  fe_mul(t0, t0, uv7);
+  fe_mul(out, t0, z);
+}
+
+/* End fe_pow22523.c */
+
+/* The first half of fe_divpowm1, up to the exponentiation */
+static void fe_divpowm1_start(fe uv7, fe v3, const fe u, const fe v) {
+  fe_sq(v3, v);
+  fe_mul(v3, v3, v); /* v3 = v^3 */
+  fe_sq(uv7, v3);
+  fe_mul(uv7, uv7, v);
+  fe_mul(uv7, uv7, u); /* uv7 = uv^7 */
+}
+
+static void fe_divpowm1(fe r, const fe u, const fe v) {
+  fe v3, uv7, t0;
 
-  /* End fe_pow22523.c */
-  /* t0 = (uv^7)^((q-5)/8) */
+  fe_divpowm1_start(uv7, v3, u, v);
+  fe_pow22523(t0, uv7); /* t0 = (uv^7)^((q-5)/8) */
   fe_mul(t0, t0, v3);
   fe_mul(r, t0, u); /* u^(m+1)v^(-(m+1)) */
 }
@@ -2196,6 +3096,438 @@ void ge_double_scalarmult_precomp_vartime(ge_p2 *r, const unsigned char *a, cons
   ge_double_scalarmult_precomp_vartime2(r, a, Ai, b, Bi);
 }
 
+/* Batched operations. Groups of four go through crypto-ops-avx2.c where
+ * available, the rest one at a time.
+ */
+
+/* Signed radix 16 digits of a, as in ge_scalarmult_base */
+static void recode_radix16(signed char *e, const unsigned char *a) {
+  signed char carry;
+  int i;
+
+  for (i = 0; i < 32; ++i) {
+    e[2 * i + 0] = (a[i] >> 0) & 15;
+    e[2 * i + 1] = (a[i] >> 4) & 15;
+  }
+  carry = 0;
+  for (i = 0; i < 63; ++i) {
+    e[i] += carry;
+    carry = e[i] + 8;
+    carry >>= 4;
+    e[i] -= carry << 4;
+  }
+  e[63] += carry;
+}
+
+void ge_scalarmult_base_batch(ge_p3 *r, const unsigned char (*a)[32], size_t n) {
+  size_t i = 0;
+
+#if defined(CRYPTO_OPS_AVX2)
+  if (ge_avx2_available()) {
+    signed char e[4][64];
+    int k;
+    for (; i + 4 <= n; i += 4) {
+      for (k = 0; k < 4; k++) {
+        recode_radix16(e[k], a[i + k]);
+      }
+      ge_scalarmult_base_x4(&r[i], e);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    ge_scalarmult_base(&r[i], a[i]);
+  }
+}
+
+void ge_scalarmult_p3_batch(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n) {
+  size_t i = 0;
+
+#if defined(CRYPTO_OPS_AVX2)
+  if (ge_avx2_available()) {
+    signed char e[4][64];
+    int k;
+    for (; i + 4 <= n; i += 4) {
+      for (k = 0; k < 4; k++) {
+        recode_radix16(e[k], a[i + k]);
+      }
+      ge_scalarmult_p3_x4(&r[i], e, &A[i]);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    ge_scalarmult_p3(&r[i], a[i], &A[i]);
+  }
+}
+
+/* Fixed scalar, many points: the digits are recoded once by
+ * ge_prepare_scalar. Without AVX2 the points go through the same steps in
+ * groups of GE_FIXED_GROUP, one after the other, so that the independent
+ * operations of different points overlap in the CPU.
+ */
+
+#define GE_FIXED_GROUP 4
+
+void ge_prepare_scalar(ge_prepared_scalar *p, const unsigned char *a) {
+  recode_radix16(p->e, a);
+}
+
+static void ge_cached_select(ge_cached *cur, const ge_cached Ai[8], unsigned char babs, unsigned char bnegative) {
+  ge_cached minuscur;
+  int j;
+
+  ge_cached_0(cur);
+  for (j = 0; j < 8; j++) {
+    ge_cached_cmov(cur, &Ai[j], equal(babs, j + 1));
+  }
+  fe_copy(minuscur.YplusX, cur->YminusX);
+  fe_copy(minuscur.YminusX, cur->YplusX);
+  fe_copy(minuscur.Z, cur->Z);
+  fe_neg(minuscur.T2d, cur->T2d);
+  ge_cached_cmov(cur, &minuscur, bnegative);
+}
+
+/* ge_scalarmult_p3 for m <= GE_FIXED_GROUP points in lock-step */
+static void ge_scalarmult_fixed_group(ge_p3 *r, const signed char *e, const ge_p3 *A, size_t m) {
+  ge_cached Ai[GE_FIXED_GROUP][8]; /* 1 * A, 2 * A, ..., 8 * A */
+  ge_cached cur;
+  ge_p1p1 t[GE_FIXED_GROUP];
+  ge_p2 h[GE_FIXED_GROUP];
+  ge_p3 u[GE_FIXED_GROUP];
+  size_t k;
+  int i, j;
+
+  for (k = 0; k < m; k++) {
+    ge_p3_to_cached(&Ai[k][0], &A[k]);
+    for (j = 0; j < 7; j++) {
+      ge_add(&t[k], &A[k], &Ai[k][j]);
+      ge_p1p1_to_p3(&u[k], &t[k]);
+      ge_p3_to_cached(&Ai[k][j + 1], &u[k]);
+    }
+    ge_p2_0(&h[k]);
+  }
+
+  for (i = 63; i >= 0; i--) {
+    signed char b = e[i];
+    unsigned char bnegative = negative(b);
+    unsigned char babs = b - (((-bnegative) & b) << 1);
+    for (j = 0; j < 3; j++) {
+      for (k = 0; k < m; k++) {
+        ge_p2_dbl(&t[k], &h[k]);
+        ge_p1p1_to_p2(&h[k], &t[k]);
+      }
+    }
+    for (k = 0; k < m; k++) {
+      ge_p2_dbl(&t[k], &h[k]);
+      ge_p1p1_to_p3(&u[k], &t[k]);
+      ge_cached_select(&cur, Ai[k], babs, bnegative);
+      ge_add(&t[k], &u[k], &cur);
+      if (i == 0)
+        ge_p1p1_to_p3(&r[k], &t[k]);
+      else
+        ge_p1p1_to_p2(&h[k], &t[k]);
+    }
+  }
+}
+
+void ge_scalarmult_fixed_batch(ge_p3 *r, const ge_prepared_scalar *a, const ge_p3 *A, size_t n) {
+  size_t i = 0, m;
+
+#if defined(CRYPTO_OPS_AVX2)
+  if (ge_avx2_available()) {
+    signed char e[4][64];
+    int k;
+    for (k = 0; k < 4; k++) {
+      memcpy(e[k], a->e, 64);
+    }
+    for (; i + 4 <= n; i += 4) {
+      ge_scalarmult_p3_x4(&r[i], e, &A[i]);
+    }
+  }
+#endif
+  for (; i < n; i += m) {
+    m = n - i < GE_FIXED_GROUP ? n - i : GE_FIXED_GROUP;
+    ge_scalarmult_fixed_group(&r[i], a->e, &A[i], m);
+  }
+}
+
+void ge_double_scalarmult_base_vartime_p3_batch(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, const unsigned char (*b)[32], size_t n) {
+  size_t i = 0;
+
+#if defined(CRYPTO_OPS_AVX2)
+  if (ge_avx2_available()) {
+    signed char ea[4][64];
+    signed char eb[4][64];
+    int k, top;
+    for (; i + 4 <= n; i += 4) {
+      /* the x4 code uses radix 16 digits, which need a[31] <= 127 */
+      for (k = 0, top = 0; k < 4; k++) {
+        top |= a[i + k][31] | b[i + k][31];
+      }
+      if (top & 0x80) {
+        for (k = 0; k < 4; k++) {
+          ge_double_scalarmult_base_vartime_p3(&r[i + k], a[i + k], &A[i + k], b[i + k]);
+        }
+        continue;
+      }
+      for (k = 0; k < 4; k++) {
+        recode_radix16(ea[k], a[i + k]);
+        recode_radix16(eb[k], b[i + k]);
+      }
+      ge_double_scalarmult_base_vartime_p3_x4(&r[i], ea, &A[i], eb);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    ge_double_scalarmult_base_vartime_p3(&r[i], a[i], &A[i], b[i]);
+  }
+}
+
+/* Multi-scalar multiplication, r = a[0] * A[0] + ... + a[n-1] * A[n-1].
+ *
+ * Straus: the points share one chain of doublings, GE_MSM_CHUNK points at a
+ * time so the tables stay on the stack. The constant time version uses the
+ * signed radix 16 digits and table of ge_scalarmult, the vartime one the
+ * sliding windows of ge_double_scalarmult_base_vartime with each table only
+ * built as far as its largest digit, so small scalars (amounts, 1) are cheap.
+ *
+ * Pippenger (vartime, from GE_MSM_PIPPENGER points): every c-bit window of
+ * every scalar drops its point into one of 2^c - 1 buckets, and the window
+ * sum is the running sum of the buckets. The cost per point is about 256 / c
+ * additions and the table is per window rather than per point.
+ */
+
+#define GE_MSM_CHUNK 32
+#define GE_MSM_PIPPENGER 128
+#define GE_MSM_MAX_WINDOW 8
+
+static void ge_p3_add(ge_p3 *r, const ge_p3 *p, const ge_p3 *q) {
+  ge_cached c;
+  ge_p1p1 t;
+
+  ge_p3_to_cached(&c, q);
+  ge_add(&t, p, &c);
+  ge_p1p1_to_p3(r, &t);
+}
+
+/* r = 2^k * r, k >= 1 */
+static void ge_p3_dbl_k(ge_p3 *r, int k) {
+  ge_p1p1 t;
+  ge_p2 s;
+
+  ge_p3_to_p2(&s, r);
+  for (; k > 1; k--) {
+    ge_p2_dbl(&t, &s);
+    ge_p1p1_to_p2(&s, &t);
+  }
+  ge_p2_dbl(&t, &s);
+  ge_p1p1_to_p3(r, &t);
+}
+
+static void ge_msm_chunk(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n) {
+  signed char e[GE_MSM_CHUNK][64];
+  ge_cached Ai[GE_MSM_CHUNK][8]; /* 1 * A, 2 * A, ..., 8 * A */
+  ge_p1p1 t;
+  ge_p3 u;
+  ge_p2 s;
+  size_t j;
+  int i;
+
+  for (j = 0; j < n; j++) {
+    recode_radix16(e[j], a[j]);
+    ge_p3_to_cached(&Ai[j][0], &A[j]);
+    for (i = 0; i < 7; i++) {
+      ge_add(&t, &A[j], &Ai[j][i]);
+      ge_p1p1_to_p3(&u, &t);
+      ge_p3_to_cached(&Ai[j][i + 1], &u);
+    }
+  }
+
+  ge_p3_0(&u);
+  for (i = 63; i >= 0; i--) {
+    ge_p3_to_p2(&s, &u);
+    ge_p2_dbl(&t, &s);
+    ge_p1p1_to_p2(&s, &t);
+    ge_p2_dbl(&t, &s);
+    ge_p1p1_to_p2(&s, &t);
+    ge_p2_dbl(&t, &s);
+    ge_p1p1_to_p2(&s, &t);
+    ge_p2_dbl(&t, &s);
+    ge_p1p1_to_p3(&u, &t);
+    for (j = 0; j < n; j++) {
+      signed char b = e[j][i];
+      unsigned char bnegative = negative(b);
+      unsigned char babs = b - (((-bnegative) & b) << 1);
+      ge_cached cur, minuscur;
+      ge_cached_0(&cur);
+      ge_cached_cmov(&cur, &Ai[j][0], equal(babs, 1));
+      ge_cached_cmov(&cur, &Ai[j][1], equal(babs, 2));
+      ge_cached_cmov(&cur, &Ai[j][2], equal(babs, 3));
+      ge_cached_cmov(&cur, &Ai[j][3], equal(babs, 4));
+      ge_cached_cmov(&cur, &Ai[j][4], equal(babs, 5));
+      ge_cached_cmov(&cur, &Ai[j][5], equal(babs, 6));
+      ge_cached_cmov(&cur, &Ai[j][6], equal(babs, 7));
+      ge_cached_cmov(&cur, &Ai[j][7], equal(babs, 8));
+      fe_copy(minuscur.YplusX, cur.YminusX);
+      fe_copy(minuscur.YminusX, cur.YplusX);
+      fe_copy(minuscur.Z, cur.Z);
+      fe_neg(minuscur.T2d, cur.T2d);
+      ge_cached_cmov(&cur, &minuscur, bnegative);
+      ge_add(&t, &u, &cur);
+      ge_p1p1_to_p3(&u, &t);
+    }
+  }
+  *r = u;
+}
+
+static void ge_msm_straus_vartime(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n) {
+  signed char aslide[GE_MSM_CHUNK][256];
+  ge_dsmp Ai[GE_MSM_CHUNK]; /* A, 3A, 5A, ..., only as far as needed */
+  ge_p1p1 t;
+  ge_p3 u, A2;
+  ge_p2 s;
+  size_t j;
+  int i, k, top, digit;
+
+  top = -1;
+  for (j = 0; j < n; j++) {
+    slide(aslide[j], a[j]);
+    for (i = 255, digit = 0; i >= 0; i--) {
+      if (aslide[j][i] && top < i) top = i;
+      if (aslide[j][i] > digit) digit = aslide[j][i];
+      if (-aslide[j][i] > digit) digit = -aslide[j][i];
+    }
+    if (digit == 0) continue;
+    ge_p3_to_cached(&Ai[j][0], &A[j]);
+    if (digit > 1) {
+      ge_p3_dbl(&t, &A[j]);
+      ge_p1p1_to_p3(&A2, &t);
+      for (k = 0; 2 * k + 1 < digit; k++) {
+        ge_add(&t, &A2, &Ai[j][k]);
+        ge_p1p1_to_p3(&u, &t);
+        ge_p3_to_cached(&Ai[j][k + 1], &u);
+      }
+    }
+  }
+
+  ge_p3_0(r);
+  if (top < 0) return;
+
+  ge_p2_0(&s);
+  for (i = top; i >= 0; i--) {
+    ge_p2_dbl(&t, &s);
+    for (j = 0; j < n; j++) {
+      if (aslide[j][i] > 0) {
+        ge_p1p1_to_p3(&u, &t);
+        ge_add(&t, &u, &Ai[j][aslide[j][i] / 2]);
+      } else if (aslide[j][i] < 0) {
+        ge_p1p1_to_p3(&u, &t);
+        ge_sub(&t, &u, &Ai[j][(-aslide[j][i]) / 2]);
+      }
+    }
+    if (i == 0)
+      ge_p1p1_to_p3(r, &t);
+    else
+      ge_p1p1_to_p2(&s, &t);
+  }
+}
+
+/* Bits pos .. pos + c - 1 of a, c <= GE_MSM_MAX_WINDOW */
+static unsigned int ge_msm_window(const unsigned char *a, int pos, int c) {
+  unsigned int v;
+  int i = pos >> 3;
+
+  v = a[i];
+  if (i + 1 < 32) v |= (unsigned int) a[i + 1] << 8;
+  return (v >> (pos & 7)) & ((1u << c) - 1);
+}
+
+static void ge_msm_pippenger(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n) {
+  ge_p3 bucket[(1 << GE_MSM_MAX_WINDOW) - 1];
+  unsigned char used[(1 << GE_MSM_MAX_WINDOW) - 1];
+  ge_p3 sum, total;
+  int c, k, w, windows, started, have_sum, have_total;
+  unsigned int d;
+  size_t j, cost, best;
+
+  /* Window minimising (256 / c) * (n + 2 * 2^c) additions */
+  for (k = 1, c = 1, best = (size_t) -1; k <= GE_MSM_MAX_WINDOW; k++) {
+    cost = (size_t) ((256 + k - 1) / k) * (n + ((size_t) 2 << k));
+    if (cost < best) {
+      best = cost;
+      c = k;
+    }
+  }
+  windows = (256 + c - 1) / c;
+
+  ge_p3_0(r);
+  started = 0;
+  for (w = windows - 1; w >= 0; w--) {
+    if (started) ge_p3_dbl_k(r, c);
+
+    memset(used, 0, sizeof(used));
+    for (j = 0; j < n; j++) {
+      d = ge_msm_window(a[j], w * c, c);
+      if (d == 0) continue;
+      if (used[d - 1]) {
+        ge_p3_add(&bucket[d - 1], &bucket[d - 1], &A[j]);
+      } else {
+        bucket[d - 1] = A[j];
+        used[d - 1] = 1;
+      }
+    }
+
+    /* total = 1 * bucket[0] + 2 * bucket[1] + ... */
+    have_sum = have_total = 0;
+    for (k = (1 << c) - 2; k >= 0; k--) {
+      if (used[k]) {
+        if (have_sum) ge_p3_add(&sum, &sum, &bucket[k]);
+        else sum = bucket[k];
+        have_sum = 1;
+      }
+      if (have_sum) {
+        if (have_total) ge_p3_add(&total, &total, &sum);
+        else total = sum;
+        have_total = 1;
+      }
+    }
+
+    if (have_total) {
+      if (started) ge_p3_add(r, r, &total);
+      else *r = total;
+      started = 1;
+    }
+  }
+}
+
+void ge_multiscalarmult(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n) {
+  ge_p3 part;
+  size_t i, m;
+
+  ge_p3_0(r);
+  for (i = 0; i < n; i += m) {
+    m = n - i < GE_MSM_CHUNK ? n - i : GE_MSM_CHUNK;
+    ge_msm_chunk(&part, &a[i], &A[i], m);
+    ge_p3_add(r, r, &part);
+  }
+}
+
+void ge_multiscalarmult_vartime(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n) {
+  ge_p3 part;
+  size_t i, m;
+
+  if (n >= GE_MSM_PIPPENGER) {
+    ge_msm_pippenger(r, a, A, n);
+    return;
+  }
+  ge_p3_0(r);
+  for (i = 0; i < n; i += m) {
+    m = n - i < GE_MSM_CHUNK ? n - i : GE_MSM_CHUNK;
+    ge_msm_straus_vartime(&part, &a[i], &A[i], m);
+    if (i == 0) *r = part;
+    else ge_p3_add(r, r, &part);
+  }
+}
+
 void ge_mul8(ge_p1p1 *r, const ge_p2 *t) {
   ge_p2 u;
   ge_p2_dbl(r, t);
@@ -2205,10 +3537,17 @@ void ge_mul8(ge_p1p1 *r, const ge_p2 *t) {
   ge_p2_dbl(r, &u);
 }
 
-void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
-  fe u, v, w, x, y, z;
-  unsigned char sign;
+/* ge_fromfe_frombytes_vartime is split around the exponentiation in
+ * fe_divpowm1 so that the batch version can run four of those at once.
+ */
+static void ge_fromfe_start(fe u, fe v, fe w, fe x, const unsigned char *s) {
+  fe y;
 
+#if defined(CRYPTO_OPS_FE51)
+  /* Unlike ge_frombytes_vartime, the top bit is part of the value: 2^255 = 19 */
+  fe_frombytes(u, s);
+  u[0] += 19 * (s[31] >> 7);
+#else
   /* From fe_frombytes.c */
 
   int64_t h0 = load_4(s);
@@ -2256,6 +3595,7 @@ void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
   u[9] = h9;
 
   /* End fe_frombytes.c */
+#endif
 
   fe_sq2(v, u); /* 2 * u^2 */
   fe_1(w);
@@ -2263,7 +3603,13 @@ void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
   fe_sq(x, w); /* w^2 */
   fe_mul(y, fe_ma2, v); /* -2 * A^2 * u^2 */
   fe_add(x, x, y); /* x = w^2 - 2 * A^2 * u^2 */
-  fe_divpowm1(r->X, w, x); /* (w / x)^(m + 1) */
+}
+
+/* r->X = (w / x)^(m + 1) on entry */
+static void ge_fromfe_finish(ge_p2 *r, const fe u, const fe v, const fe w, fe x) {
+  fe y, z;
+  unsigned char sign;
+
   fe_sq(y, r->X);
   fe_mul(x, y, x);
   fe_sub(y, w, x);
@@ -2321,6 +3667,40 @@ setsign:
 #endif
 }
 
+void ge_fromfe_frombytes_vartime(ge_p2 *r, const unsigned char *s) {
+  fe u, v, w, x;
+
+  ge_fromfe_start(u, v, w, x, s);
+  fe_divpowm1(r->X, w, x); /* (w / x)^(m + 1) */
+  ge_fromfe_finish(r, u, v, w, x);
+}
+
+void ge_fromfe_frombytes_vartime_batch(ge_p2 *r, const unsigned char (*s)[32], size_t n) {
+  fe u[4], v[4], w[4], x[4], uv7[4], v3[4], t[4];
+  size_t i, j, m;
+
+  for (i = 0; i < n; i += m) {
+    m = n - i < 4 ? n - i : 4;
+    for (j = 0; j < m; j++) {
+      ge_fromfe_start(u[j], v[j], w[j], x[j], s[i + j]);
+      fe_divpowm1_start(uv7[j], v3[j], w[j], x[j]);
+    }
+#if defined(CRYPTO_OPS_AVX2)
+    if (m == 4 && ge_avx2_available()) {
+      fe_pow22523_x4(t, (const fe *) uv7);
+    } else
+#endif
+    for (j = 0; j < m; j++) {
+      fe_pow22523(t[j], uv7[j]);
+    }
+    for (j = 0; j < m; j++) {
+      fe_mul(t[j], t[j], v3[j]);
+      fe_mul(r[i + j].X, t[j], w[j]);
+      ge_fromfe_finish(&r[i + j], u[j], v[j], w[j], x[j]);
+    }
+  }
+}
+
 void sc_0(unsigned char *s) {
   int i;
   for (i = 0; i < 32; i++) {
@@ -2328,6 +3708,14 @@ void sc_0(unsigned char *s) {
   }
 }
 
+/* l - 2, the exponent for sc_invert */
+static const unsigned char sc_lminus2[32] = {
+  0xeb, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+#if !defined(CRYPTO_OPS_SC64)
+
 void sc_reduce32(unsigned char *s) {
   int64_t s0 = 2097151 & load_3(s);
   int64_t s1 = 2097151 & (load_4(s + 2) >> 5);
@@ -3705,6 +5093,323 @@ void sc_muladd(unsigned char *s, const unsigned char *a, const unsigned char *b,
   s[31] = s11 >> 17;
 }
 
+void sc_invert(unsigned char *s, const unsigned char *a) {
+  unsigned char tab[16][32], r[32];
+  int i, d;
+
+  /* a^(l-2) with 4-bit windows */
+  memcpy(tab[1], a, 32);
+  sc_mul(tab[2], tab[1], tab[1]);
+  for (i = 3; i < 16; i++) {
+    sc_mul(tab[i], tab[i - 1], tab[1]);
+  }
+  memcpy(r, tab[sc_lminus2[31] >> 4], 32);
+  for (i = 62; i >= 0; i--) {
+    sc_mul(r, r, r);
+    sc_mul(r, r, r);
+    sc_mul(r, r, r);
+    sc_mul(r, r, r);
+    d = (sc_lminus2[i >> 1] >> (4 * (i & 1))) & 15;
+    if (d != 0) {
+      sc_mul(r, r, tab[d]);
+    }
+  }
+  memcpy(s, r, 32);
+}
+
+#else
+
+/* Radix 2^52 scalar arithmetic.
+ *
+ * A scalar is h[0]+2^52*h[1]+...+2^208*h[4] with 64-bit limbs and 128-bit
+ * products. Wide values are reduced using the special form of l: with
+ * l = 2^252 + delta, 2^260 = 256*l - D where D = 256*delta has 133 bits, so
+ * the part above 2^260 folds down as a multiple of -D. Outputs are fully
+ * reduced mod l, as with ref10, and any 32-byte value is accepted as input.
+ */
+
+typedef uint64_t sc52[5];
+
+#define SC52_MASK 0xfffffffffffffULL
+
+static const sc52 sc52_l = {
+  0x2631a5cf5d3edULL, 0xdea2f79cd6581ULL, 0x14def9ULL, 0, 0x100000000000ULL
+};
+/* D = 256*delta, and 256*l = 2^260 + D with the top limb not carried */
+static const uint64_t sc52_d[3] = {
+  0x31a5cf5d3ed00ULL, 0xa2f79cd658126ULL, 0x14def9deULL
+};
+static const sc52 sc52_256l = {
+  0x31a5cf5d3ed00ULL, 0xa2f79cd658126ULL, 0x14def9deULL, 0, 0x10000000000000ULL
+};
+
+/* load_8 is from the radix 2^51 field code, which CRYPTO_OPS_SC64 implies */
+static void sc52_frombytes(sc52 h, const unsigned char *s) {
+  uint64_t w0 = load_8(s), w1 = load_8(s + 8), w2 = load_8(s + 16), w3 = load_8(s + 24);
+
+  h[0] = w0 & SC52_MASK;
+  h[1] = ((w0 >> 52) | (w1 << 12)) & SC52_MASK;
+  h[2] = ((w1 >> 40) | (w2 << 24)) & SC52_MASK;
+  h[3] = ((w2 >> 28) | (w3 << 36)) & SC52_MASK;
+  h[4] = w3 >> 16;
+}
+
+/* h must be reduced */
+static void sc52_tobytes(unsigned char *s, const sc52 h) {
+  uint64_t w[4];
+  int i, j;
+
+  w[0] = h[0] | (h[1] << 52);
+  w[1] = (h[1] >> 12) | (h[2] << 40);
+  w[2] = (h[2] >> 24) | (h[3] << 28);
+  w[3] = (h[3] >> 36) | (h[4] << 16);
+  for (i = 0; i < 4; i++) {
+    for (j = 0; j < 8; j++) {
+      s[8 * i + j] = w[i] >> (8 * j);
+    }
+  }
+}
+
+/* h = x mod l, for x below 2^262 with 52-bit limbs below the top one.
+ * q = x >> 252 is floor(x/l) or one more, so x - q*l is within (-l, l).
+ */
+static void sc52_reduce(sc52 h, const sc52 x) {
+  uint64_t q = x[4] >> 44, mask, carry = 0;
+  int64_t borrow = 0;
+  int i;
+
+  for (i = 0; i < 5; i++) {
+    borrow += (int64_t) x[i] - (int64_t) (q * sc52_l[i]);
+    h[i] = (uint64_t) borrow & SC52_MASK;
+    borrow >>= 52;
+  }
+  mask = (uint64_t) borrow;
+  for (i = 0; i < 5; i++) {
+    carry = (carry >> 52) + h[i] + (sc52_l[i] & mask);
+    h[i] = carry & SC52_MASK;
+  }
+}
+
+/* h = x mod l for x = x[0]+2^52*x[1]+...+2^468*x[9] below 2^513 */
+static void sc52_reduce_wide(sc52 h, const uint64_t x[10]) {
+#define M(a, b) ((unsigned __int128) (a) * (b))
+  const uint64_t *hi = x + 5, *d = sc52_d;
+  unsigned __int128 t[7], c;
+  uint64_t y[8], w[5];
+  int64_t borrow;
+  sc52 z;
+  int i;
+
+  /* y = hi * D, below 2^386 */
+  t[0] = M(hi[0], d[0]);
+  t[1] = M(hi[0], d[1]) + M(hi[1], d[0]);
+  t[2] = M(hi[0], d[2]) + M(hi[1], d[1]) + M(hi[2], d[0]);
+  t[3] = M(hi[1], d[2]) + M(hi[2], d[1]) + M(hi[3], d[0]);
+  t[4] = M(hi[2], d[2]) + M(hi[3], d[1]) + M(hi[4], d[0]);
+  t[5] = M(hi[3], d[2]) + M(hi[4], d[1]);
+  t[6] = M(hi[4], d[2]);
+  c = 0;
+  for (i = 0; i < 7; i++) {
+    c += t[i];
+    y[i] = (uint64_t) c & SC52_MASK;
+    c >>= 52;
+  }
+  y[7] = (uint64_t) c;
+
+  /* w = (y >> 260) * D, below 2^260 */
+  t[0] = M(y[5], d[0]);
+  t[1] = M(y[5], d[1]) + M(y[6], d[0]);
+  t[2] = M(y[5], d[2]) + M(y[6], d[1]) + M(y[7], d[0]);
+  t[3] = M(y[6], d[2]) + M(y[7], d[1]);
+  t[4] = M(y[7], d[2]);
+  c = 0;
+  for (i = 0; i < 4; i++) {
+    c += t[i];
+    w[i] = (uint64_t) c & SC52_MASK;
+    c >>= 52;
+  }
+  w[4] = (uint64_t) (c + t[4]);
+#undef M
+
+  /* x = lo - y = lo - (y mod 2^260) + w, plus 256*l to keep it positive */
+  borrow = 0;
+  for (i = 0; i < 5; i++) {
+    borrow += (int64_t) (x[i] + w[i] + sc52_256l[i]) - (int64_t) y[i];
+    z[i] = i < 4 ? (uint64_t) borrow & SC52_MASK : (uint64_t) borrow;
+    borrow >>= 52;
+  }
+  sc52_reduce(h, z);
+}
+
+/* x = a*b + c as ten 52-bit limbs */
+static void sc52_muladd_wide(uint64_t x[10], const sc52 a, const sc52 b, const sc52 c) {
+#define M(x, y) ((unsigned __int128) (x) * (y))
+  unsigned __int128 t[9], r;
+  int i;
+
+  t[0] = M(a[0], b[0]);
+  t[1] = M(a[0], b[1]) + M(a[1], b[0]);
+  t[2] = M(a[0], b[2]) + M(a[1], b[1]) + M(a[2], b[0]);
+  t[3] = M(a[0], b[3]) + M(a[1], b[2]) + M(a[2], b[1]) + M(a[3], b[0]);
+  t[4] = M(a[0], b[4]) + M(a[1], b[3]) + M(a[2], b[2]) + M(a[3], b[1]) + M(a[4], b[0]);
+  t[5] = M(a[1], b[4]) + M(a[2], b[3]) + M(a[3], b[2]) + M(a[4], b[1]);
+  t[6] = M(a[2], b[4]) + M(a[3], b[3]) + M(a[4], b[2]);
+  t[7] = M(a[3], b[4]) + M(a[4], b[3]);
+  t[8] = M(a[4], b[4]);
+#undef M
+  r = 0;
+  for (i = 0; i < 9; i++) {
+    r += t[i];
+    if (i < 5) {
+      r += c[i];
+    }
+    x[i] = (uint64_t) r & SC52_MASK;
+    r >>= 52;
+  }
+  x[9] = (uint64_t) r;
+}
+
+static void sc52_mul(sc52 h, const sc52 a, const sc52 b) {
+  static const sc52 zero = {0, 0, 0, 0, 0};
+  uint64_t x[10];
+  sc52_muladd_wide(x, a, b, zero);
+  sc52_reduce_wide(h, x);
+}
+
+void sc_reduce(unsigned char *s) {
+  uint64_t w[8], x[10];
+  sc52 h;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    w[i] = load_8(s + 8 * i);
+  }
+  x[0] = w[0] & SC52_MASK;
+  x[1] = ((w[0] >> 52) | (w[1] << 12)) & SC52_MASK;
+  x[2] = ((w[1] >> 40) | (w[2] << 24)) & SC52_MASK;
+  x[3] = ((w[2] >> 28) | (w[3] << 36)) & SC52_MASK;
+  x[4] = ((w[3] >> 16) | (w[4] << 48)) & SC52_MASK;
+  x[5] = (w[4] >> 4) & SC52_MASK;
+  x[6] = ((w[4] >> 56) | (w[5] << 8)) & SC52_MASK;
+  x[7] = ((w[5] >> 44) | (w[6] << 20)) & SC52_MASK;
+  x[8] = ((w[6] >> 32) | (w[7] << 32)) & SC52_MASK;
+  x[9] = w[7] >> 20;
+  sc52_reduce_wide(h, x);
+  sc52_tobytes(s, h);
+}
+
+void sc_reduce32(unsigned char *s) {
+  sc52 h;
+  sc52_frombytes(h, s);
+  sc52_reduce(h, h);
+  sc52_tobytes(s, h);
+}
+
+void sc_add(unsigned char *s, const unsigned char *a, const unsigned char *b) {
+  sc52 ha, hb;
+  uint64_t carry = 0;
+  int i;
+
+  sc52_frombytes(ha, a);
+  sc52_frombytes(hb, b);
+  for (i = 0; i < 5; i++) {
+    carry = ha[i] + hb[i] + (carry >> 52);
+    ha[i] = i < 4 ? carry & SC52_MASK : carry;
+  }
+  sc52_reduce(ha, ha);
+  sc52_tobytes(s, ha);
+}
+
+void sc_sub(unsigned char *s, const unsigned char *a, const unsigned char *b) {
+  sc52 ha, hb;
+  int64_t borrow = 0;
+  int i;
+
+  /* a + 256l - b is positive and below 2^261 */
+  sc52_frombytes(ha, a);
+  sc52_frombytes(hb, b);
+  for (i = 0; i < 5; i++) {
+    borrow += (int64_t) (ha[i] + sc52_256l[i]) - (int64_t) hb[i];
+    ha[i] = i < 4 ? (uint64_t) borrow & SC52_MASK : (uint64_t) borrow;
+    borrow >>= 52;
+  }
+  sc52_reduce(ha, ha);
+  sc52_tobytes(s, ha);
+}
+
+void sc_mulsub(unsigned char *s, const unsigned char *a, const unsigned char *b, const unsigned char *c) {
+  sc52 ha, hb, hc;
+  uint64_t carry = 0, mask;
+  int64_t borrow = 0;
+  int i;
+
+  sc52_frombytes(ha, a);
+  sc52_frombytes(hb, b);
+  sc52_frombytes(hc, c);
+  sc52_mul(ha, ha, hb);
+  sc52_reduce(hc, hc);
+  /* c - ab, both reduced, plus l if negative */
+  for (i = 0; i < 5; i++) {
+    borrow += (int64_t) hc[i] - (int64_t) ha[i];
+    hc[i] = (uint64_t) borrow & SC52_MASK;
+    borrow >>= 52;
+  }
+  mask = (uint64_t) borrow;
+  for (i = 0; i < 5; i++) {
+    carry = (carry >> 52) + hc[i] + (sc52_l[i] & mask);
+    hc[i] = carry & SC52_MASK;
+  }
+  sc52_tobytes(s, hc);
+}
+
+void sc_mul(unsigned char *s, const unsigned char *a, const unsigned char *b) {
+  sc52 ha, hb;
+
+  sc52_frombytes(ha, a);
+  sc52_frombytes(hb, b);
+  sc52_mul(ha, ha, hb);
+  sc52_tobytes(s, ha);
+}
+
+void sc_muladd(unsigned char *s, const unsigned char *a, const unsigned char *b, const unsigned char *c) {
+  sc52 ha, hb, hc;
+  uint64_t x[10];
+
+  sc52_frombytes(ha, a);
+  sc52_frombytes(hb, b);
+  sc52_frombytes(hc, c);
+  sc52_muladd_wide(x, ha, hb, hc);
+  sc52_reduce_wide(ha, x);
+  sc52_tobytes(s, ha);
+}
+
+void sc_invert(unsigned char *s, const unsigned char *a) {
+  sc52 tab[16], r;
+  int i, d;
+
+  /* a^(l-2) with 4-bit windows */
+  sc52_frombytes(tab[1], a);
+  sc52_reduce(tab[1], tab[1]);
+  sc52_mul(tab[2], tab[1], tab[1]);
+  for (i = 3; i < 16; i++) {
+    sc52_mul(tab[i], tab[i - 1], tab[1]);
+  }
+  memcpy(r, tab[sc_lminus2[31] >> 4], sizeof(sc52));
+  for (i = 62; i >= 0; i--) {
+    sc52_mul(r, r, r);
+    sc52_mul(r, r, r);
+    sc52_mul(r, r, r);
+    sc52_mul(r, r, r);
+    d = (sc_lminus2[i >> 1] >> (4 * (i & 1))) & 15;
+    if (d != 0) {
+      sc52_mul(r, r, tab[d]);
+    }
+  }
+  sc52_tobytes(s, r);
+}
+
+#endif
+
 /* Assumes that a != INT64_MIN */
 static int64_t signum(int64_t a) {
   return (a >> 63) - ((-a) >> 63);
@@ -3728,3 +5433,46 @@ int sc_isnonzero(const unsigned char *s) {
     s[18] | s[19] | s[20] | s[21] | s[22] | s[23] | s[24] | s[25] | s[26] |
     s[27] | s[28] | s[29] | s[30] | s[31]) - 1) >> 8) + 1;
 }
+
+#define SC_INVERT_BATCH 64
+
+/* Montgomery's trick: one sc_invert per SC_INVERT_BATCH scalars, the rest is
+ * three sc_mul per scalar. Scalars that are 0 mod l are inverted to 0 without
+ * spoiling the others.
+ */
+void sc_batch_invert(unsigned char (*r)[32], const unsigned char (*a)[32], size_t n) {
+  unsigned char x[SC_INVERT_BATCH][32], acc[SC_INVERT_BATCH][32], inv[32];
+  unsigned char zero[SC_INVERT_BATCH];
+  size_t i, j, m;
+
+  for (i = 0; i < n; i += m) {
+    m = n - i < SC_INVERT_BATCH ? n - i : SC_INVERT_BATCH;
+    for (j = 0; j < m; j++) {
+      memcpy(x[j], a[i + j], 32);
+      sc_reduce32(x[j]);
+      zero[j] = !sc_isnonzero(x[j]);
+      if (zero[j]) {
+        x[j][0] = 1;
+      }
+      if (j == 0) {
+        memcpy(acc[0], x[0], 32);
+      } else {
+        sc_mul(acc[j], acc[j - 1], x[j]);
+      }
+    }
+    sc_invert(inv, acc[m - 1]);
+    for (j = m - 1; j > 0; j--) {
+      if (zero[j]) {
+        sc_0(r[i + j]);
+        continue;
+      }
+      sc_mul(r[i + j], inv, acc[j - 1]);
+      sc_mul(inv, inv, x[j]);
+    }
+    if (zero[0]) {
+      sc_0(r[i]);
+    } else {
+      memcpy(r[i], inv, 32);
+    }
+  }
+}
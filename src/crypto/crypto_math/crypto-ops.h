@@ -31,11 +31,44 @@
 #pragma once
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* From fe.h */
 
+/* The field backend is chosen at build time. Where the compiler has unsigned
+ * __int128 elements are five 51-bit limbs (CRYPTO_OPS_FE51), otherwise ref10's
+ * ten 25.5-bit limbs. Define CRYPTO_OPS_REF10 to force the 32-bit code.
+ */
+#if defined(__SIZEOF_INT128__) && !defined(CRYPTO_OPS_REF10)
+#define CRYPTO_OPS_FE51
+typedef uint64_t fe[5];
+#else
 typedef int32_t fe[10];
+#endif
+
+/* Scalars mod l follow the same choice: 52-bit limbs reduced with the special
+ * form of l, folding with 2^260 = -256*delta mod l (CRYPTO_OPS_SC64), or
+ * ref10's 21-bit limbs.
+ */
+#if defined(CRYPTO_OPS_FE51)
+#define CRYPTO_OPS_SC64
+#endif
+
+/* fe_invert is ref10's chain of 254 squarings unless CRYPTO_OPS_SAFEGCD is
+ * defined, which selects a constant-time divstep (safegcd) inversion. That
+ * needs the 64-bit backend and is ignored with ref10's limbs.
+ */
+#if defined(CRYPTO_OPS_SAFEGCD) && !defined(CRYPTO_OPS_FE51)
+#undef CRYPTO_OPS_SAFEGCD
+#endif
+
+/* Batched group operations run four at a time with AVX2 when the CPU has it
+ * (checked at runtime). Define CRYPTO_OPS_NO_AVX2 to leave that code out.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(CRYPTO_OPS_NO_AVX2)
+#define CRYPTO_OPS_AVX2
+#endif
 
 /* From ge.h */
 
@@ -76,6 +109,14 @@ typedef struct {
 
 void ge_add(ge_p1p1 *, const ge_p3 *, const ge_cached *);
 
+/* From ge_madd.c */
+
+void ge_madd(ge_p1p1 *, const ge_p3 *, const ge_precomp *);
+
+/* From ge_msub.c */
+
+void ge_msub(ge_p1p1 *, const ge_p3 *, const ge_precomp *);
+
 /* From ge_double_scalarmult.c, modified */
 
 typedef ge_cached ge_dsmp[8];
@@ -83,6 +124,17 @@ extern const ge_precomp ge_Bi[8];
 void ge_dsm_precomp(ge_dsmp r, const ge_p3 *s);
 void ge_double_scalarmult_base_vartime(ge_p2 *, const unsigned char *, const ge_p3 *, const unsigned char *);
 void ge_double_scalarmult_base_vartime_p3(ge_p3 *, const unsigned char *, const ge_p3 *, const unsigned char *);
+void ge_double_scalarmult_base_precomp_vartime_p3(ge_p3 *, const unsigned char *, const ge_dsmp, const unsigned char *);
+
+/* The B half of the three functions above slides over ge_Bi, width 5. Switch
+ * it to a table of the 2^(window-2) odd multiples of B, window 6..14, or back
+ * to ge_Bi with 0. The table is built here, with a single inversion, and
+ * trades memory for fewer additions (about 256/(window+1) instead of 43).
+ * Call before other threads use these functions. Returns 0 on success, -1
+ * with the previous table still in use.
+ */
+int ge_double_scalarmult_base_init(int window);
+size_t ge_double_scalarmult_base_table_size(int window);
 
 /* From ge_frombytes.c, modified */
 
@@ -114,12 +166,32 @@ void ge_p3_to_p2(ge_p2 *, const ge_p3 *);
 /* From ge_p3_tobytes.c */
 
 void ge_p3_tobytes(unsigned char *, const ge_p3 *);
+void ge_p3_tobytes_batch(unsigned char (*)[32], const ge_p3 *, size_t);
 
 /* From ge_scalarmult_base.c */
 
 extern const ge_precomp ge_base[32][8];
 void ge_scalarmult_base(ge_p3 *, const unsigned char *);
 
+/* Switch ge_scalarmult_base to a table for a signed radix 2^window comb,
+ * window 4..12, or back to ge_base with window 0. The table is generated on
+ * every call and never read from disk, since a wrong table would silently give
+ * wrong keys. Call before other threads use ge_scalarmult_base. Returns 0 on
+ * success, -1 with ge_base still in use.
+ */
+int ge_scalarmult_base_init(int window);
+size_t ge_scalarmult_base_table_size(int window);
+
+/* The rangeproof amount generator H, from crypto-ops-dataH.c which
+ * crypto-ops-gentables.c writes at build time for the selected field
+ * backend. ge_H is laid out like ge_base, ge_H2[i] is 2^i * H.
+ */
+
+extern const ge_precomp ge_H[32][8];
+extern const ge_precomp ge_H2[64];
+void ge_scalarmult_H(ge_p3 *, const unsigned char *);
+void ge_scalarmult_H_amount(ge_p3 *, uint64_t);
+
 /* From ge_tobytes.c */
 
 void ge_tobytes(unsigned char *, const ge_p2 *);
@@ -144,6 +216,7 @@ extern const fe fe_fffb3;
 extern const fe fe_fffb4;
 extern const ge_p3 ge_p3_identity;
 void ge_fromfe_frombytes_vartime(ge_p2 *, const unsigned char *);
+void ge_fromfe_frombytes_vartime_batch(ge_p2 *r, const unsigned char (*s)[32], size_t n);
 void sc_0(unsigned char *);
 void sc_reduce32(unsigned char *);
 void sc_add(unsigned char *, const unsigned char *, const unsigned char *);
@@ -154,6 +227,36 @@ void sc_muladd(unsigned char *s, const unsigned char *a, const unsigned char *b,
 int sc_check(const unsigned char *);
 int sc_isnonzero(const unsigned char *); /* Doesn't normalize */
 
+/* s = 1/a mod l, and 0 if a is 0 mod l. r[i] = 1/a[i] for n scalars with a
+ * single inversion per 64, r may be a.
+ */
+void sc_invert(unsigned char *, const unsigned char *);
+void sc_batch_invert(unsigned char (*r)[32], const unsigned char (*a)[32], size_t n);
+
+/* Batches of independent operations: r[i] = a[i] * B, r[i] = a[i] * A[i] and
+ * r[i] = a[i] * A[i] + b[i] * B. Same preconditions as the single versions.
+ */
+void ge_scalarmult_base_batch(ge_p3 *r, const unsigned char (*a)[32], size_t n);
+void ge_scalarmult_p3_batch(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n);
+void ge_double_scalarmult_base_vartime_p3_batch(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, const unsigned char (*b)[32], size_t n);
+
+/* r[i] = a * A[i] for one secret scalar and many points, such as the view
+ * key against every transaction's R. ge_prepare_scalar recodes a (a[31] <=
+ * 127) once and the prepared scalar can be reused for any number of
+ * batches. Constant time in a.
+ */
+typedef struct {
+  signed char e[64];
+} ge_prepared_scalar;
+void ge_prepare_scalar(ge_prepared_scalar *p, const unsigned char *a);
+void ge_scalarmult_fixed_batch(ge_p3 *r, const ge_prepared_scalar *a, const ge_p3 *A, size_t n);
+
+/* r = a[0] * A[0] + ... + a[n-1] * A[n-1], with a[i][31] <= 127. The vartime
+ * version switches from Straus to Pippenger for large n.
+ */
+void ge_multiscalarmult(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n);
+void ge_multiscalarmult_vartime(ge_p3 *r, const unsigned char (*a)[32], const ge_p3 *A, size_t n);
+
 // internal
 uint64_t load_3(const unsigned char *in);
 uint64_t load_4(const unsigned char *in);
@@ -161,3 +264,15 @@ void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
 void fe_add(fe h, const fe f, const fe g);
 void fe_tobytes(unsigned char *, const fe);
 void fe_invert(fe out, const fe z);
+void fe_invert_chain(fe out, const fe z);   //ref10's chain, whatever fe_invert is
+
+#if defined(CRYPTO_OPS_AVX2)
+/* crypto-ops-avx2.c, four operations on recoded scalars. Only call these
+ * when ge_avx2_available() is true.
+ */
+int ge_avx2_available(void);
+void ge_scalarmult_base_x4(ge_p3 *r, const signed char e[4][64]);
+void ge_scalarmult_p3_x4(ge_p3 *r, const signed char e[4][64], const ge_p3 *A);
+void ge_double_scalarmult_base_vartime_p3_x4(ge_p3 *r, const signed char ea[4][64], const ge_p3 *A, const signed char eb[4][64]);
+void fe_pow22523_x4(fe out[4], const fe z[4]);
+#endif
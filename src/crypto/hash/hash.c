@@ -1,23 +1,63 @@
 #include "hash.h"
 
 #include "../random.h"
+#include "../pointcache.h"
 #include "../crypto_math/crypto-ops.h"
 
 //sc_reduce: Takes a 64-byte integer and outputs the lowest 32 bytes modulo the prime q
 //sc_reduce32: Takes a 32-byte integer and outputs the integer modulo q
 
+//64 random bytes reduced mod q, so the result is uniform up to 2^-260
 void random_scalar(ec_scalar dest) {
     unsigned char temp[64];
-    gen_random_bytes(32, temp);
+    gen_random_bytes(64, temp);
     sc_reduce(temp);
     memcpy(dest, temp, 32);
+    memset(temp, 0, sizeof(temp));
 }
 
-//Only the first 32 bytes are used from the 200-byte output
+void random_scalar_batch(ec_scalar* out, size_t n) {
+    unsigned char temp[16][64];
+    size_t i, j, m;
+
+    for (i = 0; i < n; i += m) {
+        m = n - i < 16 ? n - i : 16;
+        gen_random_bytes(m * 64, temp);
+        for (j = 0; j < m; j++) {
+            sc_reduce(temp[j]);
+            memcpy(out[i + j], temp[j], 32);
+        }
+    }
+    memset(temp, 0, sizeof(temp));
+}
+
+//Keccak-256: the first 32 bytes of keccak1600, without producing the rest
 void cn_fast_hash(void* data, size_t size, unsigned char* hash) {
-    uint8_t temp[200];
-    keccak1600(data, size, temp);
-    memcpy(hash, temp, 32);
+    keccak(data, size, hash, HASH_SIZE);
+}
+
+void cn_fast_hash_x4(const void* in[4], size_t size, unsigned char* hash[4]) {
+    keccak_x4((const uint8_t**) in, size, hash, HASH_SIZE);
+}
+
+/* temp[i] = cn_fast_hash of the n inputs of size bytes at in, four at a time */
+static void cn_fast_hash_batch(const void* in, size_t size, size_t n, unsigned char (*temp)[32]) {
+    const unsigned char* p = in;
+    const void* ins[4];
+    unsigned char* outs[4];
+    size_t i;
+    int j;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        for (j = 0; j < 4; j++) {
+            ins[j] = p + (i + j) * size;
+            outs[j] = temp[i + j];
+        }
+        cn_fast_hash_x4(ins, size, outs);
+    }
+    for ( ; i < n; i++) {
+        cn_fast_hash((void*) (p + i * size), size, temp[i]);
+    }
 }
 
 void hash_to_ec(void* in, size_t size, ge_p3* out) {
@@ -31,6 +71,26 @@ void hash_to_ec(void* in, size_t size, ge_p3* out) {
    
 }
 
+/* out[i] = hash_to_ec(in[i], 32, ...) for n 32-byte inputs, sharing the
+ * square roots of ge_fromfe_frombytes_vartime four at a time
+ */
+void hash_to_ec_batch(const unsigned char (*in)[32], size_t n, ge_p3* out) {
+    unsigned char temp[64][32];
+    ge_p2 t1[64];
+    ge_p1p1 t2;
+    size_t i, j, m;
+
+    for (i = 0; i < n; i += m) {
+        m = n - i < 64 ? n - i : 64;
+        cn_fast_hash_batch(in[i], 32, m, temp);
+        ge_fromfe_frombytes_vartime_batch(t1, (const unsigned char (*)[32]) temp, m);
+        for (j = 0; j < m; j++) {
+            ge_mul8(&t2, &t1[j]);
+            ge_p1p1_to_p3(&out[i + j], &t2);
+        }
+    }
+}
+
 void hash_to_ec_point(void* in, size_t size, ec_point out) {
     ge_p3 temp;
     hash_to_ec(in, size, &temp);
@@ -42,10 +102,24 @@ void hash_to_scalar(void* in, size_t size, ec_scalar out) {
     sc_reduce32(out);
 }
 
+void hash_to_scalar_final(keccak_ctx* ctx, ec_scalar out) {
+    keccak_final(ctx, out);
+    sc_reduce32(out);
+}
+
+void hash_to_scalar_batch(const void* in, size_t size, size_t n, ec_scalar* out) {
+    size_t i;
+
+    cn_fast_hash_batch(in, size, n, out);
+    for (i = 0; i < n; i++) {
+        sc_reduce32(out[i]);
+    }
+}
+
 void generate_key_image(secret_key x, public_key pub, key_image image) {
     ge_p3 hash;
     ge_p2 res;
-    hash_to_ec(pub, 32, &hash);
+    hp_cache_hash_to_ec(&hash, NULL, pub);
     ge_scalarmult(&res, x, &hash);
     ge_tobytes(image, &res);
 }
@@ -19,15 +19,33 @@ enum {
     HASH_DATA_AREA = 136
 };
 
+//Incremental keccak state, see keccak_init
+typedef struct keccak_ctx {
+    union hash_state st;
+    size_t rsiz;    //rate in bytes
+    size_t pos;     //bytes absorbed into the current block
+    int mdlen;
+} keccak_ctx;
+
 void random_scalar(ec_scalar dest);
+//n random scalars, drawing the randomness for several at once
+void random_scalar_batch(ec_scalar* out, size_t n);
 
 //Output to a ge_p3 group element
 void hash_to_ec(void* in, size_t size, ge_p3* out);
+//hash_to_ec of n 32-byte inputs (public keys), faster than one at a time
+void hash_to_ec_batch(const unsigned char (*in)[32], size_t n, ge_p3* out);
 
 //Outputs to a point (32 byte array)
 void hash_to_ec_point(void* in, size_t size, ec_point out);
 void hash_to_scalar(void* in, size_t size, ec_scalar out);
+//hash_to_scalar of everything absorbed into ctx, started with keccak_init(ctx, HASH_SIZE)
+void hash_to_scalar_final(keccak_ctx* ctx, ec_scalar out);
 void cn_fast_hash(void* data, size_t size, unsigned char* hash);
+//cn_fast_hash of four inputs of the same size
+void cn_fast_hash_x4(const void* in[4], size_t size, unsigned char* hash[4]);
+//out[i] = hash_to_scalar of the n inputs of size bytes laid out back to back
+void hash_to_scalar_batch(const void* in, size_t size, size_t n, ec_scalar* out);
 void hash_no_reduce(void* in, size_t size, ec_scalar out);
 
 void generate_key_image(secret_key x, public_key pub, key_image image);
@@ -52,6 +70,21 @@ void keccak(const uint8_t *in, size_t inlen, uint8_t *md, int mdlen);
 // update the state
 void keccakf(uint64_t st[25], int norounds);
 
+// incremental keccak: keccak_init, keccak_update any number of times, then
+// keccak_final gives the same hash as keccak of all the input at once. A
+// state that has absorbed a common prefix can be copied with keccak_clone
+// and each copy continued with a different suffix.
+void keccak_init(keccak_ctx *ctx, int mdlen);
+void keccak_update(keccak_ctx *ctx, const uint8_t *in, size_t inlen);
+void keccak_final(keccak_ctx *ctx, uint8_t *md);
+void keccak_clone(keccak_ctx *dst, const keccak_ctx *src);
+
+// keccak of four messages of the same length
+void keccak_x4(const uint8_t *in[4], size_t inlen, uint8_t *md[4], int mdlen);
+#if defined(CRYPTO_OPS_AVX2)
+void keccak_x4_avx2(const uint8_t *in[4], size_t inlen, uint8_t *md[4], int mdlen, size_t rsiz);
+#endif
+
 void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,149 @@
+/* Four independent keccak hashes in lock-step using AVX2.
+ *
+ * Lane i of the state of all four messages lives in one __m256i, one message
+ * per 64-bit lane, and every round operation is done on all four at once.
+ * The messages have the same length, so they absorb the same number of
+ * blocks; only the final padded block is assembled per message. Called from
+ * keccak_x4 in keccak.c, which checks ge_avx2_available first.
+ */
+
+#include "hash.h"
+
+#if defined(CRYPTO_OPS_AVX2)
+
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define XOR5(a, b, c, d, e) XOR(XOR(XOR(a, b), XOR(c, d)), e)
+#define ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define ROL(a, n) _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+
+extern const uint64_t keccakf_rndc[24];
+
+static AVX2 void keccakf_x4(__m256i A[25])
+{
+    __m256i B[25], C0, C1, C2, C3, C4, D0, D1, D2, D3, D4;
+    int round;
+
+    for (round = 0; round < KECCAK_ROUNDS; round++) {
+        /* Theta */
+        C0 = XOR5(A[0], A[5], A[10], A[15], A[20]);
+        C1 = XOR5(A[1], A[6], A[11], A[16], A[21]);
+        C2 = XOR5(A[2], A[7], A[12], A[17], A[22]);
+        C3 = XOR5(A[3], A[8], A[13], A[18], A[23]);
+        C4 = XOR5(A[4], A[9], A[14], A[19], A[24]);
+        D0 = XOR(C4, ROL(C1, 1));
+        D1 = XOR(C0, ROL(C2, 1));
+        D2 = XOR(C1, ROL(C3, 1));
+        D3 = XOR(C2, ROL(C4, 1));
+        D4 = XOR(C3, ROL(C0, 1));
+        /* Rho and pi */
+        B[0] = XOR(A[0], D0);
+        B[10] = ROL(XOR(A[1], D1), 1);
+        B[20] = ROL(XOR(A[2], D2), 62);
+        B[5] = ROL(XOR(A[3], D3), 28);
+        B[15] = ROL(XOR(A[4], D4), 27);
+        B[16] = ROL(XOR(A[5], D0), 36);
+        B[1] = ROL(XOR(A[6], D1), 44);
+        B[11] = ROL(XOR(A[7], D2), 6);
+        B[21] = ROL(XOR(A[8], D3), 55);
+        B[6] = ROL(XOR(A[9], D4), 20);
+        B[7] = ROL(XOR(A[10], D0), 3);
+        B[17] = ROL(XOR(A[11], D1), 10);
+        B[2] = ROL(XOR(A[12], D2), 43);
+        B[12] = ROL(XOR(A[13], D3), 25);
+        B[22] = ROL(XOR(A[14], D4), 39);
+        B[23] = ROL(XOR(A[15], D0), 41);
+        B[8] = ROL(XOR(A[16], D1), 45);
+        B[18] = ROL(XOR(A[17], D2), 15);
+        B[3] = ROL(XOR(A[18], D3), 21);
+        B[13] = ROL(XOR(A[19], D4), 8);
+        B[14] = ROL(XOR(A[20], D0), 18);
+        B[24] = ROL(XOR(A[21], D1), 2);
+        B[9] = ROL(XOR(A[22], D2), 61);
+        B[19] = ROL(XOR(A[23], D3), 56);
+        B[4] = ROL(XOR(A[24], D4), 14);
+        /* Chi */
+        A[0] = XOR(B[0], ANDNOT(B[1], B[2]));
+        A[1] = XOR(B[1], ANDNOT(B[2], B[3]));
+        A[2] = XOR(B[2], ANDNOT(B[3], B[4]));
+        A[3] = XOR(B[3], ANDNOT(B[4], B[0]));
+        A[4] = XOR(B[4], ANDNOT(B[0], B[1]));
+        A[5] = XOR(B[5], ANDNOT(B[6], B[7]));
+        A[6] = XOR(B[6], ANDNOT(B[7], B[8]));
+        A[7] = XOR(B[7], ANDNOT(B[8], B[9]));
+        A[8] = XOR(B[8], ANDNOT(B[9], B[5]));
+        A[9] = XOR(B[9], ANDNOT(B[5], B[6]));
+        A[10] = XOR(B[10], ANDNOT(B[11], B[12]));
+        A[11] = XOR(B[11], ANDNOT(B[12], B[13]));
+        A[12] = XOR(B[12], ANDNOT(B[13], B[14]));
+        A[13] = XOR(B[13], ANDNOT(B[14], B[10]));
+        A[14] = XOR(B[14], ANDNOT(B[10], B[11]));
+        A[15] = XOR(B[15], ANDNOT(B[16], B[17]));
+        A[16] = XOR(B[16], ANDNOT(B[17], B[18]));
+        A[17] = XOR(B[17], ANDNOT(B[18], B[19]));
+        A[18] = XOR(B[18], ANDNOT(B[19], B[15]));
+        A[19] = XOR(B[19], ANDNOT(B[15], B[16]));
+        A[20] = XOR(B[20], ANDNOT(B[21], B[22]));
+        A[21] = XOR(B[21], ANDNOT(B[22], B[23]));
+        A[22] = XOR(B[22], ANDNOT(B[23], B[24]));
+        A[23] = XOR(B[23], ANDNOT(B[24], B[20]));
+        A[24] = XOR(B[24], ANDNOT(B[20], B[21]));
+
+        /* Iota */
+        A[0] = XOR(A[0], _mm256_set1_epi64x((long long) keccakf_rndc[round]));
+    }
+}
+
+static AVX2 __m256i load_x4(const uint8_t *in[4], size_t off)
+{
+    uint64_t w[4];
+    int j;
+
+    for (j = 0; j < 4; j++)
+        memcpy(&w[j], in[j] + off, 8);
+    return _mm256_loadu_si256((const __m256i *) w);
+}
+
+// keccak of four equal length messages, with rsiz the rate in bytes
+AVX2 void keccak_x4_avx2(const uint8_t *in[4], size_t inlen, uint8_t *md[4], int mdlen, size_t rsiz)
+{
+    __m256i A[25];
+    uint8_t last[4][200];
+    const uint8_t *lp[4];
+    uint64_t out[25][4], st[25];
+    size_t i, off, rsizw = rsiz / 8;
+    int j;
+
+    for (i = 0; i < 25; i++)
+        A[i] = _mm256_setzero_si256();
+
+    for (off = 0; inlen - off >= rsiz; off += rsiz) {
+        for (i = 0; i < rsizw; i++)
+            A[i] = XOR(A[i], load_x4(in, off + 8 * i));
+        keccakf_x4(A);
+    }
+
+    for (j = 0; j < 4; j++) {
+        memset(last[j], 0, rsiz);
+        memcpy(last[j], in[j] + off, inlen - off);
+        last[j][inlen - off] ^= 1;
+        last[j][rsiz - 1] ^= 0x80;
+        lp[j] = last[j];
+    }
+    for (i = 0; i < rsizw; i++)
+        A[i] = XOR(A[i], load_x4(lp, 8 * i));
+    keccakf_x4(A);
+
+    for (i = 0; i < 25; i++)
+        _mm256_storeu_si256((__m256i *) out[i], A[i]);
+    for (j = 0; j < 4; j++) {
+        for (i = 0; i < 25; i++)
+            st[i] = out[i][j];
+        memcpy(md[j], st, mdlen);
+    }
+}
+
+#endif
@@ -1,84 +1,163 @@
 // keccak.c
 // 19-Nov-11  Markku-Juhani O. Saarinen <mjos@iki.fi>
 // A baseline Keccak (3rd round) implementation.
+//
+// The permutation is now the unrolled, lane complementing round of the
+// Keccak team's optimized 64-bit code (KeccakP-1600-opt64). The state is
+// kept with lanes 1, 2, 8, 12, 17 and 20 complemented between the two
+// complementing passes, which turns most of the NOT-AND of chi into AND/OR.
 
 #include <stdio.h>
 #include <stdlib.h>
 //#include "hash-ops.h"
 #include "hash.h"
 
-const uint64_t keccakf_rndc[24] = 
+const uint64_t keccakf_rndc[24] =
 {
     0x0000000000000001, 0x0000000000008082, 0x800000000000808a,
     0x8000000080008000, 0x000000000000808b, 0x0000000080000001,
     0x8000000080008081, 0x8000000000008009, 0x000000000000008a,
     0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
     0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
-    0x8000000000008003, 0x8000000000008002, 0x8000000000000080, 
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
     0x000000000000800a, 0x800000008000000a, 0x8000000080008081,
     0x8000000000008080, 0x0000000080000001, 0x8000000080008008
 };
 
-const int keccakf_rotc[24] = 
-{
-    1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14, 
-    27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44
-};
+// One round from lanes A to lanes E, with the column parities C of A on
+// entry and of E on exit. Rows are b, g, k, m, s and columns a, e, i, o, u.
+#define KECCAK_ROUND(A, E, rc) \
+    Da = Cu ^ ROTL64(Ce, 1); \
+    De = Ca ^ ROTL64(Ci, 1); \
+    Di = Ce ^ ROTL64(Co, 1); \
+    Do = Ci ^ ROTL64(Cu, 1); \
+    Du = Co ^ ROTL64(Ca, 1); \
+\
+    B0 = A##ba ^ Da; \
+    B1 = ROTL64(A##ge ^ De, 44); \
+    B2 = ROTL64(A##ki ^ Di, 43); \
+    B3 = ROTL64(A##mo ^ Do, 21); \
+    B4 = ROTL64(A##su ^ Du, 14); \
+    E##ba = B0 ^ (B1 | B2) ^ (rc); \
+    E##be = B1 ^ (~B2 | B3); \
+    E##bi = B2 ^ (B3 & B4); \
+    E##bo = B3 ^ (B4 | B0); \
+    E##bu = B4 ^ (B0 & B1); \
+    Ca = E##ba; Ce = E##be; Ci = E##bi; Co = E##bo; Cu = E##bu; \
+\
+    B0 = ROTL64(A##bo ^ Do, 28); \
+    B1 = ROTL64(A##gu ^ Du, 20); \
+    B2 = ROTL64(A##ka ^ Da, 3); \
+    B3 = ROTL64(A##me ^ De, 45); \
+    B4 = ROTL64(A##si ^ Di, 61); \
+    E##ga = B0 ^ (B1 | B2); \
+    E##ge = B1 ^ (B2 & B3); \
+    E##gi = B2 ^ (B3 | ~B4); \
+    E##go = B3 ^ (B4 | B0); \
+    E##gu = B4 ^ (B0 & B1); \
+    Ca ^= E##ga; Ce ^= E##ge; Ci ^= E##gi; Co ^= E##go; Cu ^= E##gu; \
+\
+    B0 = ROTL64(A##be ^ De, 1); \
+    B1 = ROTL64(A##gi ^ Di, 6); \
+    B2 = ROTL64(A##ko ^ Do, 25); \
+    B3 = ROTL64(A##mu ^ Du, 8); \
+    B4 = ROTL64(A##sa ^ Da, 18); \
+    E##ka = B0 ^ (B1 | B2); \
+    E##ke = B1 ^ (B2 & B3); \
+    E##ki = B2 ^ (~B3 & B4); \
+    E##ko = ~B3 ^ (B4 | B0); \
+    E##ku = B4 ^ (B0 & B1); \
+    Ca ^= E##ka; Ce ^= E##ke; Ci ^= E##ki; Co ^= E##ko; Cu ^= E##ku; \
+\
+    B0 = ROTL64(A##bu ^ Du, 27); \
+    B1 = ROTL64(A##ga ^ Da, 36); \
+    B2 = ROTL64(A##ke ^ De, 10); \
+    B3 = ROTL64(A##mi ^ Di, 15); \
+    B4 = ROTL64(A##so ^ Do, 56); \
+    E##ma = B0 ^ (B1 & B2); \
+    E##me = B1 ^ (B2 | B3); \
+    E##mi = B2 ^ (~B3 | B4); \
+    E##mo = ~B3 ^ (B4 & B0); \
+    E##mu = B4 ^ (B0 | B1); \
+    Ca ^= E##ma; Ce ^= E##me; Ci ^= E##mi; Co ^= E##mo; Cu ^= E##mu; \
+\
+    B0 = ROTL64(A##bi ^ Di, 62); \
+    B1 = ROTL64(A##go ^ Do, 55); \
+    B2 = ROTL64(A##ku ^ Du, 39); \
+    B3 = ROTL64(A##ma ^ Da, 41); \
+    B4 = ROTL64(A##se ^ De, 2); \
+    E##sa = B0 ^ (~B1 & B2); \
+    E##se = ~B1 ^ (B2 | B3); \
+    E##si = B2 ^ (B3 & B4); \
+    E##so = B3 ^ (B4 | B0); \
+    E##su = B4 ^ (B0 & B1); \
+    Ca ^= E##sa; Ce ^= E##se; Ci ^= E##si; Co ^= E##so; Cu ^= E##su;
 
-const int keccakf_piln[24] = 
-{
-    10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4, 
-    15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1 
-};
+#define KECCAK_COPY(A, E) \
+    A##ba = E##ba; A##be = E##be; A##bi = E##bi; A##bo = E##bo; A##bu = E##bu; \
+    A##ga = E##ga; A##ge = E##ge; A##gi = E##gi; A##go = E##go; A##gu = E##gu; \
+    A##ka = E##ka; A##ke = E##ke; A##ki = E##ki; A##ko = E##ko; A##ku = E##ku; \
+    A##ma = E##ma; A##me = E##me; A##mi = E##mi; A##mo = E##mo; A##mu = E##mu; \
+    A##sa = E##sa; A##se = E##se; A##si = E##si; A##so = E##so; A##su = E##su;
 
-// update the state with given number of rounds
+// update the state with given number of rounds (at most 24)
 
 void keccakf(uint64_t st[25], int rounds)
 {
-    int i, j, round;
-    uint64_t t, bc[5];
+    uint64_t Aba, Abe, Abi, Abo, Abu, Aga, Age, Agi, Ago, Agu;
+    uint64_t Aka, Ake, Aki, Ako, Aku, Ama, Ame, Ami, Amo, Amu;
+    uint64_t Asa, Ase, Asi, Aso, Asu;
+    uint64_t Eba, Ebe, Ebi, Ebo, Ebu, Ega, Ege, Egi, Ego, Egu;
+    uint64_t Eka, Eke, Eki, Eko, Eku, Ema, Eme, Emi, Emo, Emu;
+    uint64_t Esa, Ese, Esi, Eso, Esu;
+    uint64_t B0, B1, B2, B3, B4, Ca, Ce, Ci, Co, Cu, Da, De, Di, Do, Du;
+    int round;
 
-    for (round = 0; round < rounds; round++) {
+    if (rounds > 24)
+        rounds = 24;
 
-        // Theta
-        for (i = 0; i < 5; i++)     
-            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+    Aba = st[0];  Abe = ~st[1];  Abi = ~st[2];  Abo = st[3];   Abu = st[4];
+    Aga = st[5];  Age = st[6];   Agi = st[7];   Ago = ~st[8];  Agu = st[9];
+    Aka = st[10]; Ake = st[11];  Aki = ~st[12]; Ako = st[13];  Aku = st[14];
+    Ama = st[15]; Ame = st[16];  Ami = ~st[17]; Amo = st[18];  Amu = st[19];
+    Asa = ~st[20]; Ase = st[21]; Asi = st[22];  Aso = st[23];  Asu = st[24];
 
-        for (i = 0; i < 5; i++) {
-            t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
-            for (j = 0; j < 25; j += 5)
-                st[j + i] ^= t;
-        }
-
-        // Rho Pi
-        t = st[1];
-        for (i = 0; i < 24; i++) {
-            j = keccakf_piln[i];
-            bc[0] = st[j];
-            st[j] = ROTL64(t, keccakf_rotc[i]);
-            t = bc[0];
-        }
+    Ca = Aba ^ Aga ^ Aka ^ Ama ^ Asa;
+    Ce = Abe ^ Age ^ Ake ^ Ame ^ Ase;
+    Ci = Abi ^ Agi ^ Aki ^ Ami ^ Asi;
+    Co = Abo ^ Ago ^ Ako ^ Amo ^ Aso;
+    Cu = Abu ^ Agu ^ Aku ^ Amu ^ Asu;
 
-        //  Chi
-        for (j = 0; j < 25; j += 5) {
-            for (i = 0; i < 5; i++)
-                bc[i] = st[j + i];
-            for (i = 0; i < 5; i++)
-                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
-        }
-
-        //  Iota
-        st[0] ^= keccakf_rndc[round];
+    for (round = 0; round + 2 <= rounds; round += 2) {
+        KECCAK_ROUND(A, E, keccakf_rndc[round])
+        KECCAK_ROUND(E, A, keccakf_rndc[round + 1])
+    }
+    if (round < rounds) {
+        KECCAK_ROUND(A, E, keccakf_rndc[round])
+        KECCAK_COPY(A, E)
     }
+
+    st[0] = Aba;   st[1] = ~Abe;  st[2] = ~Abi;  st[3] = Abo;   st[4] = Abu;
+    st[5] = Aga;   st[6] = Age;   st[7] = Agi;   st[8] = ~Ago;  st[9] = Agu;
+    st[10] = Aka;  st[11] = Ake;  st[12] = ~Aki; st[13] = Ako;  st[14] = Aku;
+    st[15] = Ama;  st[16] = Ame;  st[17] = ~Ami; st[18] = Amo;  st[19] = Amu;
+    st[20] = ~Asa; st[21] = Ase;  st[22] = Asi;  st[23] = Aso;  st[24] = Asu;
 }
 
 // compute a keccak hash (md) of given byte length from "in"
 typedef uint64_t state_t[25];
 
+static inline uint64_t load64(const uint8_t *p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);   // little endian, as the state is read out with memcpy
+    return w;
+}
+
 void keccak(const uint8_t *in, size_t inlen, uint8_t *md, int mdlen)
 {
     state_t st;
-    uint8_t temp[144];
+    uint8_t *stb = (uint8_t *) st;
     size_t i, rsiz, rsizw;
 
     if (mdlen <= 0 || mdlen > 200 || sizeof(st) != 200)
@@ -89,33 +168,114 @@ void keccak(const uint8_t *in, size_t inlen, uint8_t *md, int mdlen)
 
     rsiz = sizeof(state_t) == mdlen ? HASH_DATA_AREA : 200 - 2 * mdlen;
     rsizw = rsiz / 8;
-    
+
     memset(st, 0, sizeof(st));
 
+    // The 32 and 64 byte inputs of hash_to_ec, hash_to_scalar and key
+    // derivations fit in one block with whole lanes
+    if (rsiz == HASH_DATA_AREA && (inlen == 32 || inlen == 64)) {
+        for (i = 0; i < inlen / 8; i++)
+            st[i] = load64(in + 8 * i);
+        st[inlen / 8] = 1;
+        st[rsizw - 1] = 0x8000000000000000ULL;
+        keccakf(st, KECCAK_ROUNDS);
+        memcpy(md, st, mdlen);
+        return;
+    }
+
     for ( ; inlen >= rsiz; inlen -= rsiz, in += rsiz) {
         for (i = 0; i < rsizw; i++)
-            st[i] ^= ((uint64_t *) in)[i];
+            st[i] ^= load64(in + 8 * i);
         keccakf(st, KECCAK_ROUNDS);
     }
-    
-    // last block and padding
-    if (inlen >= sizeof(temp) || inlen > rsiz || rsiz - inlen + inlen + 1 >= sizeof(temp) || rsiz == 0 || rsiz - 1 >= sizeof(temp) || rsizw * 8 > sizeof(temp))
+
+    // last block and padding, xored into the state in place
+    for (i = 0; i < inlen; i++)
+        stb[i] ^= in[i];
+    stb[inlen] ^= 1;
+    stb[rsiz - 1] ^= 0x80;
+
+    keccakf(st, KECCAK_ROUNDS);
+
+    memcpy(md, st, mdlen);
+}
+
+void keccak_init(keccak_ctx *ctx, int mdlen)
+{
+    if (mdlen <= 0 || mdlen > 200)
     {
       fprintf(stderr, "Bad keccak use");
       abort();
     }
 
-    memcpy(temp, in, inlen);
-    temp[inlen++] = 1;
-    memset(temp + inlen, 0, rsiz - inlen);
-    temp[rsiz - 1] |= 0x80;
+    memset(ctx->st.w, 0, sizeof(ctx->st.w));
+    ctx->rsiz = mdlen == 200 ? HASH_DATA_AREA : 200 - 2 * mdlen;
+    ctx->pos = 0;
+    ctx->mdlen = mdlen;
+}
 
-    for (i = 0; i < rsizw; i++)
-        st[i] ^= ((uint64_t *) temp)[i];
+void keccak_update(keccak_ctx *ctx, const uint8_t *in, size_t inlen)
+{
+    size_t i, n, rsiz = ctx->rsiz;
 
-    keccakf(st, KECCAK_ROUNDS);
+    while (inlen > 0) {
+        // whole blocks go in a lane at a time
+        if (ctx->pos == 0 && inlen >= rsiz) {
+            for (i = 0; i < rsiz / 8; i++)
+                ctx->st.w[i] ^= load64(in + 8 * i);
+            keccakf(ctx->st.w, KECCAK_ROUNDS);
+            in += rsiz;
+            inlen -= rsiz;
+            continue;
+        }
 
-    memcpy(md, st, mdlen);
+        n = rsiz - ctx->pos < inlen ? rsiz - ctx->pos : inlen;
+        for (i = 0; i < n; i++)
+            ctx->st.b[ctx->pos + i] ^= in[i];
+        ctx->pos += n;
+        in += n;
+        inlen -= n;
+        if (ctx->pos == rsiz) {
+            keccakf(ctx->st.w, KECCAK_ROUNDS);
+            ctx->pos = 0;
+        }
+    }
+}
+
+// pads and outputs the hash; ctx has to be initialised again to be reused
+void keccak_final(keccak_ctx *ctx, uint8_t *md)
+{
+    ctx->st.b[ctx->pos] ^= 1;
+    ctx->st.b[ctx->rsiz - 1] ^= 0x80;
+    keccakf(ctx->st.w, KECCAK_ROUNDS);
+    memcpy(md, ctx->st.b, ctx->mdlen);
+}
+
+void keccak_clone(keccak_ctx *dst, const keccak_ctx *src)
+{
+    memcpy(dst, src, sizeof(*dst));
+}
+
+// keccak of four messages of the same length, four lanes at a time with AVX2
+void keccak_x4(const uint8_t *in[4], size_t inlen, uint8_t *md[4], int mdlen)
+{
+    int j;
+
+    if (mdlen <= 0 || mdlen > 200)
+    {
+      fprintf(stderr, "Bad keccak use");
+      abort();
+    }
+
+#if defined(CRYPTO_OPS_AVX2)
+    if (ge_avx2_available()) {
+        keccak_x4_avx2(in, inlen, md, mdlen,
+                       mdlen == 200 ? HASH_DATA_AREA : 200 - 2 * mdlen);
+        return;
+    }
+#endif
+    for (j = 0; j < 4; j++)
+        keccak(in[j], inlen, md[j], mdlen);
 }
 
 void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md)
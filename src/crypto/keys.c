@@ -1,25 +1,22 @@
 #include <stdbool.h>
+#include <string.h>
 
 #include "./crypto_math/crypto-ops.h"
 
 #include "keys.h"
+#include "pointcache.h"
 #include "random.h"
 
 /* generate a random 32-byte (256-bit) integer and copy it to res 
- * This function is not thread safe as we are using a rolling
- * keccak hash to calculate random values
+ * gen_random_bytes keeps a keccak state per thread, so this is thread safe
  */
-static inline void random_scalar_not_thread_safe(ec_scalar res) {
+static inline void random_scalar(ec_scalar res) {
     unsigned char tmp[64];
     gen_random_bytes(64, tmp);
     sc_reduce(tmp);
     memcpy(res, tmp, 32);
 }
 
-static inline void random_scalar(ec_scalar res) {
-    random_scalar_not_thread_safe(res);
-}
-
 void generate_keys(public_key pub, secret_key sk) {
     random_scalar(sk);
     secret_to_public(pub,sk);
@@ -49,8 +46,8 @@ void addKeys(ec_point out, ec_point A, ec_point B) {
     ge_cached Bcache;
     ge_p1p1 res;
 
-    ge_frombytes_vartime(&A3, A);
-    ge_frombytes_vartime(&B3, B);
+    point_cache_frombytes(&A3, A);
+    point_cache_frombytes(&B3, B);
     ge_p3_to_cached(&Bcache, &B3);
     ge_add(&res, &A3, &Bcache);
     ge_p1p1_to_p3(&A3, &res);
@@ -59,9 +56,10 @@ void addKeys(ec_point out, ec_point A, ec_point B) {
 
 //out = aG + B
 void addKeys_multBase(ec_point out, ec_scalar a, ec_point B) {
-    ec_scalar aG;
-    scalarMultBase(aG, a);
-    addKeys(out, aG, B);
+    prepared_point P;
+    point_load(&P, B);
+    point_addMultBase(&P, a, &P);
+    point_store(out, &P);
 }
 
 //out = aG + bB
@@ -71,7 +69,7 @@ void addKeys_double_multBase(ec_point out, ec_scalar a, ec_scalar b, ec_point B)
     //scalarMultBase(aG, a);
     ge_p3 B3;
     ge_p2 res;
-    ge_frombytes_vartime(&B3, B);
+    point_cache_frombytes(&B3, B);
     ge_double_scalarmult_base_vartime(&res,b,&B3,a);
     ge_tobytes(out, &res);
 }
@@ -80,8 +78,8 @@ void addKeys_double_multBase(ec_point out, ec_scalar a, ec_scalar b, ec_point B)
 void subKeys(ec_point out, ec_point A, ec_point B) {
     ge_p3 A3, B3;
     ge_p1p1 res;
-    ge_frombytes_vartime(&A3, A);
-    ge_frombytes_vartime(&B3, B);
+    point_cache_frombytes(&A3, A);
+    point_cache_frombytes(&B3, B);
     ge_cached tmp;
     ge_p3_to_cached(&tmp,&B3);
     ge_sub(&res, &A3, &tmp);
@@ -91,9 +89,10 @@ void subKeys(ec_point out, ec_point A, ec_point B) {
 
 //out = B - aG
 void subKeys_multBase(ec_point out, ec_scalar a, ec_point B) {
-    ec_point A;
-    scalarMultBase(A,a);
-    subKeys(out,B,A);
+    prepared_point P;
+    point_load(&P, B);
+    point_subMultBase(&P, a, &P);
+    point_store(out, &P);
 }
 
 void mul8(ec_point out, ec_point in) {
@@ -110,7 +109,7 @@ void scalarMult(ec_point out, ec_scalar a, ec_point B) {
     ge_p3 pointB;
     ge_p2 res;
     ge_p1p1 res8;
-    ge_frombytes_vartime(&pointB, B);
+    point_cache_frombytes(&pointB, B);
     ge_scalarmult(&res, a, &pointB);
     ge_tobytes(out, &res);
 }
@@ -119,9 +118,214 @@ void scalarMult8(ec_point out, ec_scalar a, ec_point B) {
     ge_p3 pointB;
     ge_p2 res;
     ge_p1p1 res8;
-    ge_frombytes_vartime(&pointB, B);
+    point_cache_frombytes(&pointB, B);
     ge_scalarmult(&res, a, &pointB);
     ge_mul8(&res8,&res);
     ge_p1p1_to_p2(&res,&res8);
     ge_tobytes(out, &res);
-}
\ No newline at end of file
+}
+
+/**** Batched key math ****/
+
+//Number of points converted per call into the batch functions
+#define KEYS_BATCH 64
+
+void scalarMultBase_batch(ec_point *out, ec_scalar *a, size_t n) {
+    ge_p3 res[KEYS_BATCH];
+    size_t i, m;
+
+    for (i = 0; i < n; i += m) {
+        m = n - i < KEYS_BATCH ? n - i : KEYS_BATCH;
+        ge_scalarmult_base_batch(res, (const unsigned char (*)[32]) &a[i], m);
+        ge_p3_tobytes_batch(&out[i], res, m);
+    }
+}
+
+bool addKeys_double_multBase_batch(ec_point *out, ec_scalar *a, ec_scalar *b, ec_point *B, size_t n) {
+    ge_p3 B3[KEYS_BATCH], res[KEYS_BATCH];
+    size_t i, j, m;
+
+    for (i = 0; i < n; i += m) {
+        m = n - i < KEYS_BATCH ? n - i : KEYS_BATCH;
+        //Not through the point cache, these are one-off rangeproof points
+        for (j = 0; j < m; j++) {
+            if (ge_frombytes_vartime(&B3[j], B[i + j]) != 0) {
+                return false;
+            }
+        }
+        ge_double_scalarmult_base_vartime_p3_batch(res, (const unsigned char (*)[32]) &b[i], B3, (const unsigned char (*)[32]) &a[i], m);
+        ge_p3_tobytes_batch(&out[i], res, m);
+    }
+    return true;
+}
+
+bool scalarMult8_batch(ec_point *out, bool *valid, ec_scalar a, ec_point *B, size_t n) {
+    ge_p3 B3[KEYS_BATCH], res[KEYS_BATCH];
+    ec_point bytes[KEYS_BATCH];
+    size_t index[KEYS_BATCH];
+    ge_prepared_scalar pa;
+    ge_p1p1 t;
+    ge_p2 p2;
+    size_t i, j, k, m;
+    bool all = true;
+
+    ge_prepare_scalar(&pa, a);
+    for (i = 0; i < n; i += m) {
+        m = n - i < KEYS_BATCH ? n - i : KEYS_BATCH;
+        //Transaction keys, seen once, so not through the point cache.
+        //Only the valid ones go into the batch.
+        k = 0;
+        for (j = 0; j < m; j++) {
+            bool ok = ge_frombytes_vartime(&B3[k], B[i + j]) == 0;
+            if (ok) {
+                index[k++] = i + j;
+            }
+            if (valid != NULL) {
+                valid[i + j] = ok;
+            }
+            all = all && ok;
+        }
+        ge_scalarmult_fixed_batch(res, &pa, B3, k);
+        for (j = 0; j < k; j++) {
+            ge_p3_to_p2(&p2, &res[j]);
+            ge_mul8(&t, &p2);
+            ge_p1p1_to_p3(&res[j], &t);
+        }
+        if (k == m) {
+            ge_p3_tobytes_batch(&out[i], res, m);
+        } else {
+            ge_p3_tobytes_batch(bytes, res, k);
+            for (j = 0; j < k; j++) {
+                memcpy(out[index[j]], bytes[j], 32);
+            }
+        }
+    }
+    return all;
+}
+
+/**** Prepared points ****/
+
+#define POINT_CACHED 1
+#define POINT_DSMP   2
+
+static const ge_cached *point_cached(prepared_point* P) {
+    if (!(P->flags & POINT_CACHED)) {
+        ge_p3_to_cached(&P->cached, &P->p3);
+        P->flags |= POINT_CACHED;
+    }
+    return &P->cached;
+}
+
+static void point_set_p1p1(prepared_point* out, const ge_p1p1* in) {
+    ge_p1p1_to_p3(&out->p3, in);
+    out->flags = 0;
+}
+
+bool point_load(prepared_point* P, const ec_point in) {
+    P->flags = 0;
+    return point_cache_frombytes(&P->p3, in) == 0;
+}
+
+void point_store(ec_point out, const prepared_point* P) {
+    ge_p3_tobytes(out, &P->p3);
+}
+
+void point_store_batch(ec_point* out, const prepared_point* P, size_t n) {
+    ge_p3 p3[KEYS_BATCH];
+    size_t i, j, m;
+
+    for (i = 0; i < n; i += m) {
+        m = n - i < KEYS_BATCH ? n - i : KEYS_BATCH;
+        for (j = 0; j < m; j++) {
+            p3[j] = P[i + j].p3;
+        }
+        ge_p3_tobytes_batch(&out[i], p3, m);
+    }
+}
+
+void point_identity(prepared_point* out) {
+    out->p3 = ge_p3_identity;
+    out->flags = 0;
+}
+
+//out = A + B
+void point_add(prepared_point* out, const prepared_point* A, prepared_point* B) {
+    ge_p1p1 res;
+    ge_add(&res, &A->p3, point_cached(B));
+    point_set_p1p1(out, &res);
+}
+
+//out = A - B
+void point_sub(prepared_point* out, const prepared_point* A, prepared_point* B) {
+    ge_p1p1 res;
+    ge_sub(&res, &A->p3, point_cached(B));
+    point_set_p1p1(out, &res);
+}
+
+//out = aG
+void point_multBase(prepared_point* out, ec_scalar a) {
+    ge_scalarmult_base(&out->p3, a);
+    out->flags = 0;
+}
+
+//out = aG + B
+void point_addMultBase(prepared_point* out, ec_scalar a, prepared_point* B) {
+    ge_p3 aG;
+    ge_p1p1 res;
+    ge_scalarmult_base(&aG, a);
+    ge_add(&res, &aG, point_cached(B));
+    point_set_p1p1(out, &res);
+}
+
+//out = B - aG
+void point_subMultBase(prepared_point* out, ec_scalar a, prepared_point* B) {
+    ge_p3 aG;
+    ge_cached aGcache;
+    ge_p1p1 res;
+    ge_scalarmult_base(&aG, a);
+    ge_p3_to_cached(&aGcache, &aG);
+    ge_sub(&res, &B->p3, &aGcache);
+    point_set_p1p1(out, &res);
+}
+
+//out = aG + bB
+void point_doubleMultBase(prepared_point* out, ec_scalar a, ec_scalar b, prepared_point* B) {
+    if (!(B->flags & POINT_DSMP)) {
+        ge_dsm_precomp(B->dsmp, &B->p3);
+        B->flags |= POINT_DSMP;
+    }
+    ge_double_scalarmult_base_precomp_vartime_p3(&out->p3, b, B->dsmp, a);
+    out->flags = 0;
+}
+
+//out = a*B
+void point_scalarMult(prepared_point* out, ec_scalar a, const prepared_point* B) {
+    ge_p3 res;
+    ge_scalarmult_p3(&res, a, &B->p3);
+    out->p3 = res;
+    out->flags = 0;
+}
+
+//out = 8*a*B
+void point_scalarMult8(prepared_point* out, ec_scalar a, const prepared_point* B) {
+    ge_p2 res;
+    ge_p1p1 res8;
+    ge_scalarmult(&res, a, &B->p3);
+    ge_mul8(&res8, &res);
+    point_set_p1p1(out, &res8);
+}
+
+//out = 8*A
+void point_mul8(prepared_point* out, const prepared_point* A) {
+    ge_p2 A2;
+    ge_p1p1 res;
+    ge_p3_to_p2(&A2, &A->p3);
+    ge_mul8(&res, &A2);
+    point_set_p1p1(out, &res);
+}
+
+//out = amount*H
+void point_multH(prepared_point* out, uint64_t amount) {
+    ge_scalarmult_H_amount(&out->p3, amount);
+    out->flags = 0;
+}
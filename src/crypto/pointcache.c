@@ -0,0 +1,314 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pointcache.h"
+#include "random.h"
+#include "./hash/hash.h"
+
+#define CACHE_SHARDS 16
+#define CACHE_NONE UINT32_MAX
+
+/* Both caches are the same sharded LRU map from a 32-byte key to a value of
+ * fixed size. Each entry is this header followed by the value.
+ */
+typedef struct cache_entry {
+    unsigned char key[32];
+    uint32_t prev, next;    //LRU list of the shard, most recent first
+    uint32_t chain;         //Next entry in the same bucket
+} cache_entry;
+
+typedef struct cache_shard {
+    pthread_mutex_t lock;
+    unsigned char* entries;
+    uint32_t* buckets;
+    uint32_t mask;          //Number of buckets - 1
+    uint32_t capacity, used;
+    uint32_t head, tail;
+    uint64_t hits, misses;
+} cache_shard;
+
+typedef struct lru_cache {
+    cache_shard* shards;
+    size_t value_size;
+    size_t stride;          //Bytes per entry, header and value
+    //Keys come from other people's transactions, so the table is keyed
+    //with a random seed to keep them from filling one bucket
+    uint64_t seed;
+} lru_cache;
+
+typedef struct point_value {
+    ge_p3 p3;
+    int valid;
+} point_value;
+
+typedef struct hp_value {
+    ge_p3 hp;
+    ge_dsmp pre;
+} hp_value;
+
+static lru_cache points = { .value_size = sizeof(point_value) };
+static lru_cache hashes = { .value_size = sizeof(hp_value) };
+
+static cache_entry* entry(const lru_cache* c, const cache_shard* shard, uint32_t i) {
+    return (cache_entry*) (shard->entries + (size_t) i * c->stride);
+}
+
+static void* entry_value(cache_entry* e) {
+    return (unsigned char*) e + sizeof(cache_entry);
+}
+
+static uint64_t cache_hash(const lru_cache* c, const unsigned char* s) {
+    uint64_t h = c->seed, w;
+    for (size_t i = 0; i < 32; i += 8) {
+        memcpy(&w, s + i, 8);
+        h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static void cache_release(lru_cache* c) {
+    if (c->shards == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < CACHE_SHARDS; i++) {
+        pthread_mutex_destroy(&c->shards[i].lock);
+        free(c->shards[i].entries);
+        free(c->shards[i].buckets);
+    }
+    free(c->shards);
+    c->shards = NULL;
+}
+
+static bool cache_init(lru_cache* c, size_t capacity) {
+    size_t per_shard, buckets;
+
+    cache_release(c);
+    if (capacity == 0) {
+        return true;
+    }
+
+    per_shard = (capacity + CACHE_SHARDS - 1) / CACHE_SHARDS;
+    if (per_shard >= CACHE_NONE / 2) {
+        return false;
+    }
+    for (buckets = 1; buckets < per_shard; buckets <<= 1);
+    c->stride = (sizeof(cache_entry) + c->value_size + 15) & ~(size_t) 15;
+
+    c->shards = calloc(CACHE_SHARDS, sizeof(cache_shard));
+    if (c->shards == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < CACHE_SHARDS; i++) {
+        cache_shard* shard = &c->shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->entries = malloc(per_shard * c->stride);
+        shard->buckets = malloc(buckets * sizeof(uint32_t));
+        if (shard->entries == NULL || shard->buckets == NULL) {
+            cache_release(c);
+            return false;
+        }
+        memset(shard->buckets, 0xff, buckets * sizeof(uint32_t));
+        shard->mask = buckets - 1;
+        shard->capacity = per_shard;
+        shard->head = shard->tail = CACHE_NONE;
+    }
+    gen_random_bytes(sizeof(c->seed), &c->seed);
+    return true;
+}
+
+static void cache_stats(const lru_cache* c, uint64_t* hits, uint64_t* misses) {
+    *hits = *misses = 0;
+    if (c->shards == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < CACHE_SHARDS; i++) {
+        pthread_mutex_lock(&c->shards[i].lock);
+        *hits += c->shards[i].hits;
+        *misses += c->shards[i].misses;
+        pthread_mutex_unlock(&c->shards[i].lock);
+    }
+}
+
+static void lru_unlink(const lru_cache* c, cache_shard* shard, uint32_t i) {
+    cache_entry* e = entry(c, shard, i);
+    if (e->prev != CACHE_NONE) {
+        entry(c, shard, e->prev)->next = e->next;
+    } else {
+        shard->head = e->next;
+    }
+    if (e->next != CACHE_NONE) {
+        entry(c, shard, e->next)->prev = e->prev;
+    } else {
+        shard->tail = e->prev;
+    }
+}
+
+static void lru_push(const lru_cache* c, cache_shard* shard, uint32_t i) {
+    cache_entry* e = entry(c, shard, i);
+    e->prev = CACHE_NONE;
+    e->next = shard->head;
+    if (shard->head != CACHE_NONE) {
+        entry(c, shard, shard->head)->prev = i;
+    } else {
+        shard->tail = i;
+    }
+    shard->head = i;
+}
+
+static uint32_t shard_find(const lru_cache* c, cache_shard* shard, uint32_t bucket, const unsigned char* key) {
+    uint32_t i = shard->buckets[bucket];
+    while (i != CACHE_NONE && memcmp(entry(c, shard, i)->key, key, 32) != 0) {
+        i = entry(c, shard, i)->chain;
+    }
+    return i;
+}
+
+//Take a free entry, or the least recently used one out of its bucket
+static uint32_t shard_alloc(const lru_cache* c, cache_shard* shard) {
+    uint32_t i, *link;
+
+    if (shard->used < shard->capacity) {
+        return shard->used++;
+    }
+    i = shard->tail;
+    lru_unlink(c, shard, i);
+    link = &shard->buckets[cache_hash(c, entry(c, shard, i)->key) & shard->mask];
+    while (*link != i) {
+        link = &entry(c, shard, *link)->chain;
+    }
+    *link = entry(c, shard, i)->chain;
+    return i;
+}
+
+//Copy the value for key to value and return true, or count a miss
+static bool cache_get(lru_cache* c, const unsigned char* key, void* value) {
+    uint64_t h = cache_hash(c, key);
+    cache_shard* shard = &c->shards[h >> 60];
+    uint32_t i;
+
+    pthread_mutex_lock(&shard->lock);
+    i = shard_find(c, shard, h & shard->mask, key);
+    if (i == CACHE_NONE) {
+        shard->misses++;
+        pthread_mutex_unlock(&shard->lock);
+        return false;
+    }
+    memcpy(value, entry_value(entry(c, shard, i)), c->value_size);
+    lru_unlink(c, shard, i);
+    lru_push(c, shard, i);
+    shard->hits++;
+    pthread_mutex_unlock(&shard->lock);
+    return true;
+}
+
+//Add key unless another thread got there first
+static void cache_put(lru_cache* c, const unsigned char* key, const void* value) {
+    uint64_t h = cache_hash(c, key);
+    cache_shard* shard = &c->shards[h >> 60];
+    uint32_t bucket = h & shard->mask;
+    cache_entry* e;
+    uint32_t i;
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard_find(c, shard, bucket, key) == CACHE_NONE) {
+        i = shard_alloc(c, shard);
+        e = entry(c, shard, i);
+        memcpy(e->key, key, 32);
+        memcpy(entry_value(e), value, c->value_size);
+        e->chain = shard->buckets[bucket];
+        shard->buckets[bucket] = i;
+        lru_push(c, shard, i);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+    /* ======================================== */
+    /*          Decompressed points             */
+    /* ======================================== */
+
+bool point_cache_init(size_t capacity) {
+    return cache_init(&points, capacity);
+}
+
+void point_cache_stats(uint64_t* hits, uint64_t* misses) {
+    cache_stats(&points, hits, misses);
+}
+
+int point_cache_frombytes(ge_p3* r, const unsigned char* s) {
+    point_value v;
+
+    if (points.shards == NULL) {
+        return ge_frombytes_vartime(r, s);
+    }
+    if (!cache_get(&points, s, &v)) {
+        //The square root is done without holding a lock
+        v.valid = ge_frombytes_vartime(&v.p3, s) == 0;
+        cache_put(&points, s, &v);
+    }
+    *r = v.p3;
+    return v.valid ? 0 : -1;
+}
+
+    /* ======================================== */
+    /*            Hashes to points              */
+    /* ======================================== */
+
+bool hp_cache_init(size_t capacity) {
+    return cache_init(&hashes, capacity);
+}
+
+void hp_cache_stats(uint64_t* hits, uint64_t* misses) {
+    cache_stats(&hashes, hits, misses);
+}
+
+void hp_cache_hash_to_ec(ge_p3* hp, ge_dsmp pre, const unsigned char* pub) {
+    hp_value v;
+
+    if (hashes.shards == NULL) {
+        hash_to_ec((void*) pub, 32, hp);
+        if (pre != NULL) {
+            ge_dsm_precomp(pre, hp);
+        }
+        return;
+    }
+    if (!cache_get(&hashes, pub, &v)) {
+        hash_to_ec((void*) pub, 32, &v.hp);
+        ge_dsm_precomp(v.pre, &v.hp);
+        cache_put(&hashes, pub, &v);
+    }
+    *hp = v.hp;
+    if (pre != NULL) {
+        memcpy(pre, v.pre, sizeof(ge_dsmp));
+    }
+}
+
+void hp_cache_hash_to_ec_batch(ge_dsmp* pre, const unsigned char (*pub)[32], size_t n) {
+    unsigned char miss[64][32];
+    size_t idx[64];
+    ge_p3 hp[64];
+    hp_value v;
+    size_t i, j, m;
+
+    for (i = 0; i < n; ) {
+        //Collect up to 64 keys the cache doesn't have
+        for (m = 0; i < n && m < 64; i++) {
+            if (hashes.shards != NULL && cache_get(&hashes, pub[i], &v)) {
+                memcpy(pre[i], v.pre, sizeof(ge_dsmp));
+            } else {
+                memcpy(miss[m], pub[i], 32);
+                idx[m++] = i;
+            }
+        }
+        hash_to_ec_batch((const unsigned char (*)[32]) miss, m, hp);
+        for (j = 0; j < m; j++) {
+            ge_dsm_precomp(pre[idx[j]], &hp[j]);
+            if (hashes.shards != NULL) {
+                v.hp = hp[j];
+                memcpy(v.pre, pre[idx[j]], sizeof(ge_dsmp));
+                cache_put(&hashes, miss[j], &v);
+            }
+        }
+    }
+}
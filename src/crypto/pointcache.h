@@ -0,0 +1,47 @@
+#ifndef POINTCACHE_H
+#define POINTCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./crypto_math/crypto-ops.h"
+
+/* Caches of per-key point work, keyed by the 32-byte public key
+ *
+ * The same output keys show up as ring members in many signatures, and each
+ * appearance costs a square root to decompress the key and a hash to point
+ * plus its ge_dsm_precomp table for the R side of the ring. When enabled,
+ * signatures.c, keys.c and generate_key_image look keys up here first.
+ *
+ * Each cache is split into shards with a lock each and evicts the least
+ * recently used entry of a shard when it is full. Lookups are thread safe;
+ * the init functions are not and must be called before other threads use
+ * the cache. Both caches are disabled until initialised.
+ */
+
+//Enable the cache of decompressed points with room for about capacity keys
+//(roughly 200 bytes each), dropping any previous contents. 0 disables it.
+//Returns false if the memory could not be allocated, and the cache is then
+//disabled. Entries also remember encodings that are not valid points.
+bool point_cache_init(size_t capacity);
+
+//Lookups answered from the cache and lookups that had to decompress
+void point_cache_stats(uint64_t* hits, uint64_t* misses);
+
+//ge_frombytes_vartime through the cache: 0 if s is a valid point, -1 if not
+int point_cache_frombytes(ge_p3* r, const unsigned char* s);
+
+//As point_cache_init, for H_p(pub) and its table (roughly 1.5 KB each)
+bool hp_cache_init(size_t capacity);
+void hp_cache_stats(uint64_t* hits, uint64_t* misses);
+
+//hp = H_p(pub), as hash_to_ec computes it, and pre = its ge_dsm_precomp
+//table unless pre is NULL
+void hp_cache_hash_to_ec(ge_p3* hp, ge_dsmp pre, const unsigned char* pub);
+
+//pre[i] = the ge_dsm_precomp table of H_p(pub[i]), with the keys missing
+//from the cache hashed together by hash_to_ec_batch
+void hp_cache_hash_to_ec_batch(ge_dsmp* pre, const unsigned char (*pub)[32], size_t n);
+
+#endif
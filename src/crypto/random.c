@@ -1,3 +1,5 @@
+#define _GNU_SOURCE     //syscall(2)
+
 #include "random.h"
 #include "./hash/hash.h"
 
@@ -11,18 +13,52 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <err.h>
+#include <errno.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
-union hash_state state;
-bool init = false;
+/* Each thread has its own keccak sponge, seeded from the system on first use
+ * and again every RANDOM_RESEED_BYTES of output and after fork. Output is
+ * squeezed from the rate of the state, and after every request the state is
+ * permuted and its rate zeroed, so the state left behind does not give away
+ * bytes that were already handed out (fast key erasure).
+ */
+#define RANDOM_RATE HASH_DATA_AREA
+#define RANDOM_RESEED_BYTES (1 << 20)
 
-void random_bytes_system(size_t n, void* dest) {
+typedef struct {
+    union hash_state state;
+    size_t output;              //bytes since the last reseed
+    unsigned long generation;   //fork_generation when seeded
+    bool seeded;
+    bool deterministic;         //set by random_seed, never reseeded
+} rng_state;
+
+static __thread rng_state rng;
+
+//Bumped in the child after fork so it does not repeat the parent's output
+static unsigned long fork_generation;
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;
+
+static void rng_fork_child(void) {
+    fork_generation++;
+}
+
+static void rng_fork_init(void) {
+    pthread_atfork(NULL, NULL, rng_fork_child);
+}
+
+static void random_bytes_urandom(size_t n, void* dest) {
     int fd = open("/dev/urandom", O_RDONLY);
     if (fd < 0) {
         err(EXIT_FAILURE, "error opening /dev/urandom");
     } else {
         ssize_t res = read(fd, dest, n);
-        if (res < n) {
+        if (res < 0 || (size_t) res < n) {
             err(EXIT_FAILURE, "error reading /dev/urandom");
         }
 
@@ -30,26 +66,87 @@ void random_bytes_system(size_t n, void* dest) {
     close(fd);
 }
 
+//n bytes from getrandom(2), or /dev/urandom on kernels without it
+void random_bytes_system(size_t n, void* dest) {
+#if defined(__linux__) && defined(SYS_getrandom)
+    unsigned char* p = dest;
+    while (n > 0) {
+        long res = syscall(SYS_getrandom, p, n, 0);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOSYS) {
+                random_bytes_urandom(n, p);
+                return;
+            }
+            err(EXIT_FAILURE, "error calling getrandom");
+        }
+        p += res;
+        n -= res;
+    }
+#else
+    random_bytes_urandom(n, dest);
+#endif
+}
+
+//Mix 32 fresh bytes from the system into this thread's state
+static void rng_reseed(void) {
+    union hash_state seed;
+    size_t i;
+
+    pthread_once(&fork_once, rng_fork_init);
+    random_bytes_system(32, seed.b);
+    for (i = 0; i < 4; i++) {
+        rng.state.w[i] ^= seed.w[i];
+    }
+    keccakf(rng.state.w, KECCAK_ROUNDS);
+    memset(&seed, 0, sizeof(seed));
+
+    rng.output = 0;
+    rng.generation = fork_generation;
+    rng.seeded = true;
+    rng.deterministic = false;
+}
+
+void random_seed(const void* seed, size_t n) {
+    keccak1600(seed, n, rng.state.b);
+    rng.output = 0;
+    rng.seeded = true;
+    rng.deterministic = true;
+}
+
+void random_unseed(void) {
+    memset(&rng.state, 0, sizeof(rng.state));
+    rng.seeded = false;
+}
+
 void init_rng() {
-    random_bytes_system(32, &state);
+    rng_reseed();
 }
 
-//Not thread safe
+//Thread safe, each thread draws from its own state
 void gen_random_bytes(size_t n, void* dest) {
-    if (!init) {
-        init_rng();
+    unsigned char* p = dest;
+    size_t m;
+
+    if (!rng.seeded || (!rng.deterministic &&
+            (rng.generation != fork_generation || rng.output >= RANDOM_RESEED_BYTES))) {
+        rng_reseed();
     }
-    for (;;) {
-        keccakf(&state,25);
-        if (n <= HASH_DATA_AREA) {
-            memcpy(dest, &state, n);
-            return;
-        } else {
-            memcpy(dest,&state,HASH_DATA_AREA);
-            dest = dest + HASH_DATA_AREA; //Move pointer along to next chunk of bytes
-            n -= HASH_DATA_AREA;
-        }
+    rng.output += n;
+
+    while (n > 0) {
+        keccakf(rng.state.w, KECCAK_ROUNDS);
+        m = n < RANDOM_RATE ? n : RANDOM_RATE;
+        memcpy(p, rng.state.b, m);
+        p += m;
+        n -= m;
     }
+
+    //Forget: the rate is lost, so the permutation cannot be run backwards
+    keccakf(rng.state.w, KECCAK_ROUNDS);
+    memset(rng.state.b, 0, RANDOM_RATE);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,4 +1,19 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
 #include <stddef.h>
 
 //void random_bytes_system(size_t n, void* dest);
-void gen_random_bytes(size_t n, void* dest);
\ No newline at end of file
+//Cryptographically secure random bytes, safe to call from any thread
+void gen_random_bytes(size_t n, void* dest);
+
+/* Make this thread's random bytes, and so its random scalars, keys and
+ * signatures, a fixed function of seed until random_unseed. Only for tests,
+ * benchmarks and comparing backends: the output is as secret as the seed.
+ * Other threads are not affected.
+ */
+void random_seed(const void* seed, size_t n);
+//Go back to seeding from the system
+void random_unseed(void);
+
+#endif
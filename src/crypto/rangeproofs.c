@@ -49,38 +49,56 @@ void generateBorromean(key64 x, key64 P1, key64 P2, bits indicies, borromean_sig
     key64 R[2];     //The rings we are signing will have 2 members
     key64 alpha;    //Random scalar (k_i)
 
-    int val = 0;    //Binary value we are proving (0 or 1)
-    int prime = 0;  //Complimentary of val (opposite)
+    //The point multiplications of each step are independent, so they are
+    //batched: index[j] is the ring of the j'th entry of s, c, P, h and out
+    key64 s, c, P, h, out;
+    size_t index[64];
+    size_t n = 0;
 
-    ec_scalar c;
-    ec_point temp;
+    int val = 0;    //Binary value we are proving (0 or 1)
 
-    //Go through each 2^i
+    //Random k_i, and random s for each ring's non-signing member. The s1 of
+    //rings signed at index 1 and the s0 of those at index 0 are replaced below
+    random_scalar_batch(alpha, 64);
+    random_scalar_batch(sig->s1, 64);
+    random_scalar_batch(sig->s0, 64);
+    scalarMultBase_batch(out, alpha, 64);
     for (size_t i = 0; i < 64; i++) {
         val = indicies[i];
-        prime = (val + 1) % 2;
-        random_scalar(alpha[i]);
-        scalarMultBase(R[val][i], alpha[i]);    //R_val,j = k_i*G
+        memcpy(R[val][i], out[i], 32);                      //R_val,j = k_i*G
         if (val == 0) {
-            random_scalar(sig->s1[i]);
-            hash_to_scalar(R[val][i],32,c);     //e = H(R_i,j)
-            addKeys_double_multBase(R[prime][i],sig->s1[i],c,P2[i]); //R_prime,j = s_i*G + e*P_i
+            memcpy(h[n], R[val][i], 32);
+            memcpy(s[n], sig->s1[i], 32);
+            memcpy(P[n], P2[i], 32);
+            index[n++] = i;
         }
     }
+    hash_to_scalar_batch(h, 32, n, c);                      //e = H(R_i,j)
+    addKeys_double_multBase_batch(out, s, c, P, n);         //R_prime,j = s_i*G + e*P_i
+    for (size_t j = 0; j < n; j++) {
+        memcpy(R[1][index[j]], out[j], 32);
+    }
 
     //Need to create a version that takes in a key64
     hash_to_scalar(R[1][0],64*32,sig->e0);                  //e0 = H(R_0||...||R_n)
 
+    n = 0;
     for (size_t i = 0; i < 64; i++) {
         if (indicies[i] == 0) {
             sc_mulsub(sig->s0[i], x[i], sig->e0, alpha[i]); //s_0,i = k_i - x_i*e_0
         } else {
-            random_scalar(sig->s0[i]);
-            addKeys_double_multBase(temp, sig->s0[i], sig->e0, P1[i]);
-            hash_to_scalar(temp,32,c);                      //c = H(s_0,i*G + e_0*P1_i)
-            sc_mulsub(sig->s1[i], x[i],c,alpha[i]);         //s_1,i = k_i, x_i*c
+            memcpy(s[n], sig->s0[i], 32);
+            memcpy(c[n], sig->e0, 32);
+            memcpy(P[n], P1[i], 32);
+            index[n++] = i;
         }
     }
+    addKeys_double_multBase_batch(out, s, c, P, n);         //s_0,i*G + e_0*P1_i
+    hash_to_scalar_batch(out, 32, n, c);                    //c = H(s_0,i*G + e_0*P1_i)
+    for (size_t j = 0; j < n; j++) {
+        size_t i = index[j];
+        sc_mulsub(sig->s1[i], x[i],c[j],alpha[i]);          //s_1,i = k_i, x_i*c
+    }
 }
 
 /* Verify a Borromean ring signature
@@ -92,14 +110,18 @@ void generateBorromean(key64 x, key64 P1, key64 P2, bits indicies, borromean_sig
  * PUT ALGORITHM HERE
  */
 bool verifyBorromean(key64 P1, key64 P2, borromean_sig* sig) {
-    ec_scalar c, e;
-    ec_point t;
-    key64 R;
+    ec_scalar e;
+    key64 t, c, R;
 
     for (size_t i = 0; i < 64; i++) {
-        addKeys_double_multBase(t, sig->s0[i], sig->e0, P1[i]); //t = s_0,i*G + e0*P1_i
-        hash_to_scalar(t, 32, c);                               //c = e_i,j = H(t)
-        addKeys_double_multBase(R[i],sig->s1[i],c,P2[i]);       //R_i = s_1,i*G + c*P2_i
+        memcpy(c[i], sig->e0, 32);
+    }
+    if (!addKeys_double_multBase_batch(t, sig->s0, c, P1, 64)) {   //t = s_0,i*G + e0*P1_i
+        return false;
+    }
+    hash_to_scalar_batch(t, 32, 64, c);                         //c = e_i,j = H(t)
+    if (!addKeys_double_multBase_batch(R, sig->s1, c, P2, 64)) {   //R_i = s_1,i*G + c*P2_i
+        return false;
     }
     hash_to_scalar(R,64*32,e);                                  //e = H(R_0||...||R_n)
     return isByteArraysEqual(e,sig->e0,32);                     //e ?= e0
@@ -118,7 +140,6 @@ void proveRange(key C, key mask, uint64_t amount, range_proof* proof) {
     //uint64_t amt = 1000;
     
     sc_0(mask);
-    set_identity(C);
 
     bits b;
     d2b(b,amount);
@@ -126,19 +147,31 @@ void proveRange(key C, key mask, uint64_t amount, range_proof* proof) {
 
     size_t i = 0;
 
-    ge_p3 temp_p3;
+    //The sums are kept as points and compressed in one batch at the end
+    ge_p3 Ci3[64], CiH3[64], C3;
+    ge_cached tmp;
+    ge_p1p1 res;
+
+    random_scalar_batch(ai, 64);
+    ge_scalarmult_base_batch(Ci3, (const unsigned char (*)[32]) ai, 64);  //Commit to 0,  c_i=a_i*G
+
+    C3 = ge_p3_identity;
     for (i = 0; i < 64; i++) {
-        random_scalar(ai[i]);
-        if (b[i] == 0) {                            //Commit to 0,  c_i=a_i*G
-            scalarMultBase(Ci[i], ai[i]);
-        } else if (b[i] == 1) {                     //Commit to 1, c_i=a_i*G + 2^i * H
-            addKeys_multBase(Ci[i],ai[i],H2[i]);
+        if (b[i] == 1) {                            //Commit to 1, c_i=a_i*G + 2^i * H
+            ge_madd(&res, &Ci3[i], &ge_H2[i]);
+            ge_p1p1_to_p3(&Ci3[i], &res);
         }
 
-        subKeys(CiH[i], Ci[i], H2[i]);              //CiH = C_i - 2^i * H
+        ge_msub(&res, &Ci3[i], &ge_H2[i]);          //CiH = C_i - 2^i * H
+        ge_p1p1_to_p3(&CiH3[i], &res);
         sc_add(mask,mask,ai[i]);                    //Add this sub-mask to mask
-        addKeys(C, C, Ci[i]);                       //Add c_i to total C
+        ge_p3_to_cached(&tmp, &Ci3[i]);             //Add c_i to total C
+        ge_add(&res, &C3, &tmp);
+        ge_p1p1_to_p3(&C3, &res);
     }
+    ge_p3_tobytes_batch(Ci, Ci3, 64);
+    ge_p3_tobytes_batch(CiH, CiH3, 64);
+    ge_p3_tobytes(C, &C3);
 
     generateBorromean(ai, Ci, CiH, b, &proof->sig);
 
@@ -151,21 +184,91 @@ void proveRange(key C, key mask, uint64_t amount, range_proof* proof) {
 bool verifyRange(key C, range_proof* proof) {
     key64 CiH;
     key calcC;  //Calculated C
-    set_identity(calcC);
+    ge_p3 Ci3, CiH3[64], C3;
+    ge_cached tmp;
+    ge_p1p1 res;
 
-    for (size_t i = 0; i < 64; i++) {    
-        subKeys(CiH[i], proof->Ci[i], H2[i]);       //CiH = C_i - 2^i * H
-        addKeys(calcC, calcC, proof->Ci[i]);        //C += c_i
+    C3 = ge_p3_identity;
+    for (size_t i = 0; i < 64; i++) {
+        if (ge_frombytes_vartime(&Ci3, proof->Ci[i]) != 0) {
+            return false;
+        }
+        ge_msub(&res, &Ci3, &ge_H2[i]);             //CiH = C_i - 2^i * H
+        ge_p1p1_to_p3(&CiH3[i], &res);
+        ge_p3_to_cached(&tmp, &Ci3);                //C += c_i
+        ge_add(&res, &C3, &tmp);
+        ge_p1p1_to_p3(&C3, &res);
     }
 
+    ge_p3_tobytes(calcC, &C3);
     if (!isByteArraysEqual(calcC, C, 32)) {
         return false;
     }
     
     //If the C's add up, check the proof
+    ge_p3_tobytes_batch(CiH, CiH3, 64);
     return verifyBorromean(proof->Ci, CiH, &proof->sig);
 }
 
+/* out = amount*H, from the precomputed table for H
+ */
+void amountMultH(key out, uint64_t amount) {
+    prepared_point res;
+    point_multH(&res, amount);
+    point_store(out, &res);
+}
+
+/* Convert val to a little-endian scalar
+ */
+void d2h(key out, uint64_t val) {
+    sc_0(out);
+    for (size_t i = 0; i < 8; i++) {
+        out[i] = val & 0xff;
+        val >>= 8;
+    }
+}
+
+//sum = C_0 + ... + C_n-1, false if any C_i is not a valid point
+static bool sum_commitments(ge_p3* sum, key* C, size_t n) {
+    ge_p3 point;
+    ge_cached tmp;
+    ge_p1p1 p1;
+
+    *sum = ge_p3_identity;
+    for (size_t i = 0; i < n; i++) {
+        if (ge_frombytes_vartime(&point, C[i]) != 0) {
+            return false;
+        }
+        ge_p3_to_cached(&tmp, &point);
+        ge_add(&p1, sum, &tmp);
+        ge_p1p1_to_p3(sum, &p1);
+    }
+    return true;
+}
+
+/* Check that the commitments of a transaction balance:
+ *  sum(pseudoOuts) == sum(outPk) + fee*H
+ *  The commitments are summed with one point addition each, fee*H comes from
+ *  the precomputed table.
+ */
+bool verifyCommitmentBalance(key* pseudoOuts, size_t nIn, key* outPk, size_t nOut, uint64_t fee) {
+    ge_p3 sums[2], feeH;
+    ge_cached tmp;
+    ge_p1p1 p1;
+    key sumBytes[2];
+
+    if (!sum_commitments(&sums[0], pseudoOuts, nIn) || !sum_commitments(&sums[1], outPk, nOut)) {
+        return false;
+    }
+    ge_scalarmult_H_amount(&feeH, fee);
+    ge_p3_to_cached(&tmp, &feeH);
+    ge_add(&p1, &sums[1], &tmp);
+    ge_p1p1_to_p3(&sums[1], &p1);
+
+    ge_p3_tobytes_batch(sumBytes, sums, 2);
+    return isByteArraysEqual(sumBytes[0], sumBytes[1], 32);
+}
+
 /* Encode the mask and amount:
  *  mask = mask + H(secret)
  *  amount = amount + H(H(secret))
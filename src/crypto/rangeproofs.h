@@ -49,6 +49,19 @@ void proveRange(key C, key mask, uint64_t amount, range_proof* proof);
  */
 bool verifyRange(key C, range_proof* proof);
 
+//out = amount*H, using the precomputed table for H
+void amountMultH(key out, uint64_t amount);
+
+//Amount as a little-endian scalar
+void d2h(key out, uint64_t val);
+
+/* Check that a transaction's commitments balance
+ *  pseudoOuts: Commitments to the input amounts
+ *  outPk:      Commitments to the output amounts
+ *  fee:        Fee, committed to with a zero mask
+ */
+bool verifyCommitmentBalance(key* pseudoOuts, size_t nIn, key* outPk, size_t nOut, uint64_t fee);
+
 //Encrypt the key/mask by adding the shared secret
 void ecdhEncode(key mask, key amount, key secret);
 
@@ -1,4 +1,7 @@
+#include <stdlib.h>
+
 #include "signatures.h"
+#include "pointcache.h"
 #include "./hash/hash.h"
 #include "./crypto_math/crypto-ops.h"
 #include "../utils/utils.h"
@@ -8,20 +11,18 @@
  * 
  *  L = sG + cP
  *  R = sH(P) + cI
+ *
+ * pubhash_pre is the precomputed H(P), see hash_ring
  */
-void calc_LR(char* L_curBytes, char* R_curBytes, ec_scalar c_prev, ec_scalar s, public_key pub, ge_dsmp image_pre) {
+void calc_LR(char* L_curBytes, char* R_curBytes, ec_scalar c_prev, ec_scalar s, public_key pub, ge_dsmp pubhash_pre, ge_dsmp image_pre) {
     ge_p3 pub_cur;
-    ge_p3 pubhash_cur;
-    ge_dsmp pubhash_pre;
     ge_p3 L_cur;
     ge_p3 R_cur;
     ge_p2 temp_p2;
-    ge_frombytes_vartime(&pub_cur, pub);
+    point_cache_frombytes(&pub_cur, pub);   //Decoys recur across rings
     ge_double_scalarmult_base_vartime(&temp_p2, c_prev, &pub_cur, s);
     ge_tobytes(L_curBytes, &temp_p2);
 
-    hash_to_ec(pub, 32, &pubhash_cur);
-    ge_dsm_precomp(pubhash_pre, &pubhash_cur);
     ge_double_scalarmult_precomp_vartime2_p3(&R_cur,s,pubhash_pre,c_prev,image_pre);
     ge_p3_tobytes(R_curBytes, &R_cur);
 }
@@ -35,11 +36,42 @@ void calc_LR_secret(char* L_curBytes, char* R_curBytes, ec_scalar s, public_key
     ge_p3 L_cur, R_cur;
     ge_scalarmult_base(&L_cur, s);
     ge_p3_tobytes(L_curBytes, &L_cur);
-    hash_to_ec(pub, 32, &pubhash_cur);
+    hp_cache_hash_to_ec(&pubhash_cur, NULL, pub);
     ge_scalarmult_p3(&R_cur, s, &pubhash_cur);
     ge_p3_tobytes(R_curBytes, &R_cur);
 }
 
+/* c = H(msg, L, R), with msg already absorbed into msg_ctx
+ */
+static void calc_c_hash(char* c, const char* L_curBytes, const char* R_curBytes, const keccak_ctx* msg_ctx) {
+    keccak_ctx ctx;
+    keccak_clone(&ctx, msg_ctx);
+    keccak_update(&ctx, (const uint8_t*) L_curBytes, 32);
+    keccak_update(&ctx, (const uint8_t*) R_curBytes, 32);
+    hash_to_scalar_final(&ctx, c);
+}
+
+/* Precomputed H(P) for the n public keys of a ring, hashed together rather
+ * than one per calc_LR. Free the result.
+ */
+static ge_dsmp* hash_ring(const public_key* pubs, size_t n) {
+    ge_dsmp* pres = malloc(n*sizeof(ge_dsmp));
+    hp_cache_hash_to_ec_batch(pres, (const unsigned char (*)[32]) pubs, n);
+    return pres;
+}
+
+/* As hash_ring for all members of an MLSAG matrix, pres[i*m + j] for pub_vectors[i][j] */
+static ge_dsmp* hash_ring_matrix(public_key** pub_vectors, size_t n, size_t m) {
+    public_key* pubs = malloc(n*m*sizeof(public_key));
+    ge_dsmp* pres;
+    for (size_t i = 0; i < n; i++) {
+        memcpy(pubs[i*m], pub_vectors[i], m*sizeof(public_key));
+    }
+    pres = hash_ring(pubs, n*m);
+    free(pubs);
+    return pres;
+}
+
 /* Generate a LWW signature as described in MRL-0005 Section 2.1
  * Generated on an arbitrary sized message, msg
  * Index is the index of the pubs vector in which sec is the corresponding secret key
@@ -51,9 +83,9 @@ void generatellw(const char* msg, size_t msg_size, const vector_public_key* pubs
     ec_scalar s[n];
     ec_scalar c;
 
-    int toHash_size = msg_size+32+32;
-    char toHash[toHash_size];           //This stores the stuff we hash to get c
-    memcpy(toHash, msg, msg_size);
+    keccak_ctx msg_ctx;                 //The message, absorbed once for every c
+    keccak_init(&msg_ctx, HASH_SIZE);
+    keccak_update(&msg_ctx, (const uint8_t*) msg, msg_size);
 
     ge_p3 key_image_p3;
     ge_frombytes_vartime(&key_image_p3, image);
@@ -62,13 +94,12 @@ void generatellw(const char* msg, size_t msg_size, const vector_public_key* pubs
 
     char L_curBytes[32];
     char R_curBytes[32];
+    ge_dsmp* pubhash_pres = hash_ring(pub_keys, n);
 
     int i = index;    
     random_scalar(s[i]);
     calc_LR_secret(L_curBytes, R_curBytes, s[i], pub_keys[i]);
-    memcpy(toHash+(toHash_size-64), L_curBytes, 32);
-    memcpy(toHash+(toHash_size-32), R_curBytes, 32);
-    hash_to_scalar(toHash, toHash_size, c);
+    calc_c_hash(c, L_curBytes, R_curBytes, &msg_ctx);
 
     i = (i + 1) % n;
     if (i == 0) {
@@ -80,10 +111,8 @@ void generatellw(const char* msg, size_t msg_size, const vector_public_key* pubs
     while (i != index) {
         random_scalar(s[i]);
 
-        calc_LR(L_curBytes, R_curBytes, c, s[i], pub_keys[i], image_pre);
-        memcpy(toHash+(toHash_size-64), L_curBytes, 32);
-        memcpy(toHash+(toHash_size-32), R_curBytes, 32);
-        hash_to_scalar(toHash, toHash_size, c);
+        calc_LR(L_curBytes, R_curBytes, c, s[i], pub_keys[i], pubhash_pres[i], image_pre);
+        calc_c_hash(c, L_curBytes, R_curBytes, &msg_ctx);
 
         i = (i + 1) % n;
         if (i == 0) {
@@ -93,6 +122,7 @@ void generatellw(const char* msg, size_t msg_size, const vector_public_key* pubs
         printHex(c, 32);
     }
 
+    free(pubhash_pres);
     sc_mulsub(s[index],c,sec,s[index]);
 
     for (i = 0; i < n; i++) {
@@ -115,9 +145,9 @@ bool verifyllw(const char* msg, size_t msg_size, vector_public_key* pubs, ring_s
     memcpy(&c_cur,&sig->c1,32);
     ec_scalar* s = sig->s;
 
-    int toHash_size = msg_size+32+32;
-    char toHash[toHash_size];           //This stores the stuff we hash to get c
-    memcpy(toHash, msg, msg_size);
+    keccak_ctx msg_ctx;                 //The message, absorbed once for every c
+    keccak_init(&msg_ctx, HASH_SIZE);
+    keccak_update(&msg_ctx, (const uint8_t*) msg, msg_size);
 
     ge_p3 key_image_p3;
     ge_frombytes_vartime(&key_image_p3, image);
@@ -126,6 +156,7 @@ bool verifyllw(const char* msg, size_t msg_size, vector_public_key* pubs, ring_s
 
     char L_curBytes[32];
     char R_curBytes[32];
+    ge_dsmp* pubhash_pres = hash_ring(pub_keys, n);
 
     printf("c_0: ");
     printHex(c_cur,32);
@@ -133,31 +164,31 @@ bool verifyllw(const char* msg, size_t msg_size, vector_public_key* pubs, ring_s
     int i = 0;
     while (i < n) {
         //calc_c_value(&c_cur,s[i],pub_keys[i],image_pre,toHash,toHash_size);
-        calc_LR(L_curBytes, R_curBytes, c_cur, s[i], pub_keys[i], image_pre);
-        memcpy(toHash+(toHash_size-64), L_curBytes, 32);
-        memcpy(toHash+(toHash_size-32), R_curBytes, 32);
-        hash_to_scalar(toHash, toHash_size, c_cur);
+        calc_LR(L_curBytes, R_curBytes, c_cur, s[i], pub_keys[i], pubhash_pres[i], image_pre);
+        calc_c_hash(c_cur, L_curBytes, R_curBytes, &msg_ctx);
         i = (i + 1);
         printf("c_%d: ", i);
         printHex(c_cur, 32);
     }
+    free(pubhash_pres);
 
     return isByteArraysEqual(sig->c1, c_cur,32);
 }
 
 /*
  * Calculates the hash of the message given L and R MLSAG vectors
- * L and R are vectors of size m
+ * L and R are vectors of size m, prefix holds the absorbed message
  * 
- * c = H(L_1, R_1, . . ., L_m, R_m)
+ * c = H(prefix, L_1, R_1, . . ., L_m, R_m)
  */
-void calc_c_hashV(char* c, char** L, char** R, int m, char* toHash, int prefix_size) {
-    //int m = L.n;
+void calc_c_hashV(char* c, char** L, char** R, int m, const keccak_ctx* prefix) {
+    keccak_ctx ctx;
+    keccak_clone(&ctx, prefix);
     for (size_t i = 0; i < m; i++) {
-        memcpy(toHash+prefix_size+(32*(2*i)), L[i], 32);
-        memcpy(toHash+prefix_size+( 32*((2*i)+1) ), R[i], 32);
+        keccak_update(&ctx, (const uint8_t*) L[i], 32);
+        keccak_update(&ctx, (const uint8_t*) R[i], 32);
     }
-    hash_to_scalar(toHash, prefix_size+(32*(m*2)), c);
+    hash_to_scalar_final(&ctx, c);
 }
 
 /*Generate a Multilayered Linkable Spontaneous Anonymous Group Signature (MLSAG) 
@@ -181,9 +212,9 @@ void generateMLSAG(const char* prefix, const matrix_public_key* pubM, const vect
         R_curBytes[i] = malloc(32);
     }
 
-    int toHash_size = 32 + 64*vector_size;
-    char toHash[toHash_size];
-    memcpy(toHash, prefix, 32);
+    keccak_ctx prefix_ctx;
+    keccak_init(&prefix_ctx, HASH_SIZE);
+    keccak_update(&prefix_ctx, (const uint8_t*) prefix, 32);
 
     //Generate precomputed ge_dsmp values for key images as we will need these later
     ge_dsmp image_pres[vector_size];
@@ -193,6 +224,7 @@ void generateMLSAG(const char* prefix, const matrix_public_key* pubM, const vect
         ge_frombytes_vartime(&key_image_p3, imageV->images[j]);
         ge_dsm_precomp(image_pres[j], &key_image_p3);
     }
+    ge_dsmp* pubhash_pres = hash_ring_matrix(pub_vectors, ring_size, vector_size);
 
     //Generate the c value for index+1 (Section 2.2 MRL-0005)
     int ring_i = index;
@@ -203,7 +235,7 @@ void generateMLSAG(const char* prefix, const matrix_public_key* pubM, const vect
         calc_LR_secret(L_curBytes[j], R_curBytes[j], s[ring_i][j], cur_pub_vector[j]);
     }
     //c = H(L_1, R_1, . . ., L_m, R_m)
-    calc_c_hashV(c, L_curBytes, R_curBytes, vector_size, toHash, 32);
+    calc_c_hashV(c, L_curBytes, R_curBytes, vector_size, &prefix_ctx);
 
     ring_i = (ring_i + 1) % ring_size;
     if (ring_i == 0) {
@@ -214,10 +246,10 @@ void generateMLSAG(const char* prefix, const matrix_public_key* pubM, const vect
         cur_pub_vector = pub_vectors[ring_i];
         for (size_t j = 0; j < vector_size; j++) {
             random_scalar(s[ring_i][j]);
-            calc_LR(L_curBytes[j], R_curBytes[j], c, s[ring_i][j], cur_pub_vector[j], image_pres[j]);
+            calc_LR(L_curBytes[j], R_curBytes[j], c, s[ring_i][j], cur_pub_vector[j], pubhash_pres[ring_i*vector_size + j], image_pres[j]);
         }
 
-        calc_c_hashV(c, L_curBytes, R_curBytes, vector_size, toHash, 32);
+        calc_c_hashV(c, L_curBytes, R_curBytes, vector_size, &prefix_ctx);
 
         ring_i = (ring_i + 1) % ring_size;
         if (ring_i == 0) {
@@ -225,6 +257,8 @@ void generateMLSAG(const char* prefix, const matrix_public_key* pubM, const vect
         }
     }
 
+    free(pubhash_pres);
+
     for (size_t j = 0; j < vector_size; j++) {
         //s_j = s_j(old) + c*x_j % l
         sc_mulsub(s[index][j], c, secV->sec_keys[j],s[index][j]);
@@ -255,9 +289,9 @@ bool verifyMLSAG(const char* prefix, const matrix_public_key* pubM, mlsag_sig* s
         R_curBytes[i] = malloc(32);
     }
 
-    int toHash_size = 32 + 64*vector_size;
-    char toHash[toHash_size];
-    memcpy(toHash, prefix, 32);
+    keccak_ctx prefix_ctx;
+    keccak_init(&prefix_ctx, HASH_SIZE);
+    keccak_update(&prefix_ctx, (const uint8_t*) prefix, 32);
 
     ge_dsmp image_pres[vector_size];
     ge_p3 key_image_p3;
@@ -266,6 +300,7 @@ bool verifyMLSAG(const char* prefix, const matrix_public_key* pubM, mlsag_sig* s
         ge_frombytes_vartime(&key_image_p3, imageV.images[i]);
         ge_dsm_precomp(image_pres[i], &key_image_p3);
     }
+    ge_dsmp* pubhash_pres = hash_ring_matrix(pub_vectors, ring_size, vector_size);
 
     int ring_i = 0;
     public_key* cur_pub_vector;
@@ -273,12 +308,13 @@ bool verifyMLSAG(const char* prefix, const matrix_public_key* pubM, mlsag_sig* s
     while (ring_i < ring_size) {
         cur_pub_vector = pub_vectors[ring_i];
         for (size_t j = 0; j < vector_size; j++) {
-            calc_LR(L_curBytes[j], R_curBytes[j], c, s[ring_i][j], cur_pub_vector[j], image_pres[j]);
+            calc_LR(L_curBytes[j], R_curBytes[j], c, s[ring_i][j], cur_pub_vector[j], pubhash_pres[ring_i*vector_size + j], image_pres[j]);
         }
 
-        calc_c_hashV(c, L_curBytes, R_curBytes, vector_size, toHash, 32);
+        calc_c_hashV(c, L_curBytes, R_curBytes, vector_size, &prefix_ctx);
 
         ring_i = (ring_i + 1);       
     }
+    free(pubhash_pres);
     return isByteArraysEqual(sig->c1, c, 32);
 }
\ No newline at end of file
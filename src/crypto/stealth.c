@@ -17,6 +17,22 @@ void derivation_to_scalar(ec_scalar out, ec_point key, size_t output_index) {
     hash_to_scalar(toHash, 32+size, out);
 } 
 
+/* The view tag of an output, the first byte of H("view_tag" || key || n)
+ * as in Monero. It lets a scanner that has computed key = aR rule out
+ * nearly all outputs that are not its own without any further point math
+ */
+unsigned char derivation_to_view_tag(ec_point key, size_t output_index) {
+    int ind_size = (sizeof(size_t) * 8 + 6) / 7;
+    char toHash[8+32+ind_size];
+    unsigned char hash[32];
+    memcpy(toHash,"view_tag",8);
+    memcpy(toHash+8,key,32);
+    size_t size;
+    size = write_varint(toHash+40, output_index);
+    cn_fast_hash(toHash, 40+size, hash);
+    return hash[0];
+}
+
 /* Constructs a one-time public key for destination address (A,B)
  * 
  *  if rand is true, then we are not passing the r to the function
@@ -27,22 +43,42 @@ void derivation_to_scalar(ec_scalar out, ec_point key, size_t output_index) {
  *  1. Choose a random r in [1, l - 1]
  *  2. Compute the one time public key: P = H(rA || n)G + B
  *  3. Calculate R = rG, which the receiver uses to recover the corresponding private keys
+ *  4. If view_tag is true, also set addr->view_tag
  */ 
-void generateStealth(public_key A, public_key B, stealth_address* addr, bool rand, size_t output_index, bool sub) {
+static void generate_stealth(public_key A, public_key B, stealth_address* addr, bool rand, size_t output_index, bool sub, bool view_tag) {
     ec_scalar temp_hash;
     ec_point rA;
-    
+    ec_point out[2];
+    prepared_point A3, B3, PR[2];
+
     if (rand) {
         random_scalar(addr->r);                     //random r
     }
-    scalarMult8(rA, addr->r, A);      
+    point_load(&A3, A);
+    point_load(&B3, B);
+    point_scalarMult8(&PR[0], addr->r, &A3);
+    point_store(rA, &PR[0]);
     derivation_to_scalar(temp_hash,rA,output_index);       //H(rA || n) 
-    addKeys_multBase(addr->pub, temp_hash, B);  //P = H(rA)G + B
+    if (view_tag) {
+        addr->view_tag = derivation_to_view_tag(rA,output_index);
+    }
+    point_addMultBase(&PR[0], temp_hash, &B3);  //P = H(rA)G + B
     if (sub) {
-        scalarMult(addr->R,addr->r,B);              //R = rB (sD in MRL)
+        point_scalarMult(&PR[1], addr->r, &B3);     //R = rB (sD in MRL)
     } else {
-        scalarMultBase(addr->R, addr->r);           //R = rG
+        point_multBase(&PR[1], addr->r);            //R = rG
     }
+    point_store_batch(out, PR, 2);                  //One inversion for P and R
+    memcpy(addr->pub, out[0], 32);
+    memcpy(addr->R, out[1], 32);
+}
+
+void generateStealth(public_key A, public_key B, stealth_address* addr, bool rand, size_t output_index, bool sub) {
+    generate_stealth(A, B, addr, rand, output_index, sub, false);
+}
+
+void generateStealthViewTag(public_key A, public_key B, stealth_address* addr, bool rand, size_t output_index, bool sub) {
+    generate_stealth(A, B, addr, rand, output_index, sub, true);
 }
 
 /* Determine if the public address is owned
@@ -52,24 +88,106 @@ void generateStealth(public_key A, public_key B, stealth_address* addr, bool ran
  * 
  *  Calculate if the output of H(aR)G + B is equal to pub, if so return true and D is all 0
  *  If not, then set D = pub - H(aR)G and return false
+ *  D may be NULL, and is not set if pub, R or B is not a valid point
  */
-bool isStealthMine(public_key D, public_key pub, public_key R, secret_key a, public_key B, size_t output_index) {
+static bool stealth_mine(public_key D, public_key pub, public_key R, secret_key a, public_key B, size_t output_index, const unsigned char* view_tag) {
     ec_scalar temp_hash;
     ec_point aR, P;
+    prepared_point R3, B3, HG;
 
-    scalarMult8(aR,a,R);                    //a*R
+    if (!point_load(&R3, R) || !point_load(&B3, B)) {
+        return false;
+    }
+    point_scalarMult8(&HG, a, &R3);             //a*R
+    point_store(aR, &HG);
+    if (view_tag != NULL && derivation_to_view_tag(aR,output_index) != *view_tag) {
+        return false;
+    }
     derivation_to_scalar(temp_hash,aR,output_index);       //H(aR || n) 
-    addKeys_multBase(P, temp_hash, B);      //P' = H(aR)G + B
+    point_multBase(&HG, temp_hash);             //H(aR)G, shared by P' and D
+    point_add(&B3, &HG, &B3);                   //P' = H(aR)G + B
+    point_store(P, &B3);
     if (isByteArraysEqual(P, pub, 32)) {   //P ?= P'
         if (D != NULL) {
             memset(D,  0x00, 32);
         }
         return true;
     }
-    subKeys_multBase(D, temp_hash, pub);    //D = P - H(aR)G
+    if (D != NULL && point_load(&B3, pub)) {
+        point_sub(&B3, &B3, &HG);               //D = P - H(aR)G
+        point_store(D, &B3);
+    }
     return false;
 }
 
+bool isStealthMine(public_key D, public_key pub, public_key R, secret_key a, public_key B, size_t output_index) {
+    return stealth_mine(D, pub, R, a, B, output_index, NULL);
+}
+
+/* isStealthMine for an output with a view tag. If the tag does not match the
+ * output is neither ours nor any of our subaddresses', and D is not set
+ */
+bool isStealthMineViewTag(public_key D, public_key pub, public_key R, secret_key a, public_key B, size_t output_index, unsigned char view_tag) {
+    return stealth_mine(D, pub, R, a, B, output_index, &view_tag);
+}
+
+/* Scan all n outputs of one transaction for those owned by (a,B)
+ *  pubs - The destination public keys, pubs[i] for output index i
+ *  view_tags - NULL, or the view tags of the outputs
+ *  R - tx public key
+ *
+ *  aR is computed once for the transaction rather than once per output.
+ *  owned[i] is set if pubs[i] = H(aR || i)G + B, and scalars[i] = H(aR || i)
+ *  for every output whose view tag, if any, matches, for
+ *  getStealthKeyFromScalar. D may be NULL, as for isStealthMine. D[i] is set
+ *  for every output: 0 if it is owned, fails its view tag or its key is not
+ *  a valid point, so a reused D never holds a key from another transaction.
+ *  Returns the number of owned outputs, or -1 (nothing set) if R or B is not
+ *  a valid point
+ */
+int scanStealthTx(bool* owned, ec_scalar* scalars, public_key* D, const public_key* pubs, const unsigned char* view_tags, size_t n, public_key R, secret_key a, public_key B) {
+    ec_scalar temp_hash;
+    ec_point aR, P;
+    prepared_point R3, B3, HG, P3;
+    int found = 0;
+
+    if (!point_load(&R3, R) || !point_load(&B3, B)) {
+        return -1;
+    }
+    point_scalarMult8(&HG, a, &R3);             //a*R, shared by all outputs
+    point_store(aR, &HG);
+
+    for (size_t i = 0; i < n; i++) {
+        if (view_tags != NULL && derivation_to_view_tag(aR,i) != view_tags[i]) {
+            owned[i] = false;                   //Not to us, skip the hash and point math
+            if (D != NULL) {
+                memset(D[i], 0x00, 32);
+            }
+            continue;
+        }
+        derivation_to_scalar(temp_hash,aR,i);   //H(aR || i)
+        memcpy(scalars[i], temp_hash, 32);
+        point_multBase(&HG, temp_hash);         //H(aR)G, shared by P' and D
+        point_add(&P3, &HG, &B3);               //P' = H(aR)G + B
+        point_store(P, &P3);
+        owned[i] = isByteArraysEqual(P, (unsigned char*) pubs[i], 32);
+        if (owned[i]) {
+            if (D != NULL) {
+                memset(D[i], 0x00, 32);
+            }
+            found++;
+        } else if (D != NULL) {
+            if (point_load(&P3, pubs[i])) {
+                point_sub(&P3, &P3, &HG);       //D = P - H(aR)G
+                point_store(D[i], &P3);
+            } else {
+                memset(D[i], 0x00, 32);
+            }
+        }
+    }
+    return found;
+}
+
 /* Get the one-time private key from a stealth address
  *  priv - pointer to where the private key will be stored
  *  R - transaction public key
@@ -87,4 +205,11 @@ void getStealthKey(secret_key priv, public_key R, secret_key a, secret_key b, si
     derivation_to_scalar(temp_hash,aR,output_index);   //H(rA || n)
     //don't use add_keys since we are just adding scalars, not points
     sc_add(priv,temp_hash,b);               //x = H(rA ||n) + b
-}
\ No newline at end of file
+}
+
+/* getStealthKey from the H(aR || n) that scanStealthTx returned
+ *  x = H(aR || n) + b
+ */
+void getStealthKeyFromScalar(secret_key priv, ec_scalar derivation, secret_key b) {
+    sc_add(priv,derivation,b);
+}
@@ -9,10 +9,30 @@ typedef struct stealth_address {
     ec_scalar r;    //Private
     ec_point R;     //Transaction public key
     ec_point pub;   //One-time destination public key
+    unsigned char view_tag; //Optional fast reject for scanners, see generateStealthViewTag
 } stealth_address;
 
 void generateStealth(public_key A, public_key B, stealth_address* addr, bool rand, size_t output_index, bool sub);
+//generateStealth that also sets addr->view_tag, for an extra hash per output
+void generateStealthViewTag(public_key A, public_key B, stealth_address* addr, bool rand, size_t output_index, bool sub);
+//The view tag of output output_index for the derivation key = rA = aR
+unsigned char derivation_to_view_tag(ec_point key, size_t output_index);
 bool isStealthMine(public_key D, public_key pub, public_key R, secret_key a, public_key B, size_t output_index);
+//isStealthMine that first compares the view tag, skipping the point math for
+//about 255 in 256 outputs that are not ours
+bool isStealthMineViewTag(public_key D, public_key pub, public_key R, secret_key a, public_key B, size_t output_index, unsigned char view_tag);
 void getStealthKey(secret_key priv, public_key R, secret_key a, secret_key b, size_t output_index);
 
+/* isStealthMine for all n outputs of a transaction, deriving aR once.
+ * owned[i] says if pubs[i] is ours. view_tags is NULL, or the n view tags of
+ * the outputs to check first. scalars[i] = H(aR || i) is only set for outputs
+ * that pass the view tag. D is NULL or n keys as from isStealthMine, 0 for
+ * owned outputs and those that fail the tag or have an invalid key.
+ * Returns the number of owned outputs, or -1 if R or B is invalid
+ */
+int scanStealthTx(bool* owned, ec_scalar* scalars, public_key* D, const public_key* pubs, const unsigned char* view_tags, size_t n, public_key R, secret_key a, public_key B);
+
+//priv = derivation + b, the getStealthKey of an output found by scanStealthTx
+void getStealthKeyFromScalar(secret_key priv, ec_scalar derivation, secret_key b);
+
 #endif
\ No newline at end of file
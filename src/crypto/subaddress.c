@@ -1,5 +1,15 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "subaddress.h"
+#include "stealth.h"
 #include "./hash/hash.h"
+#include "../utils/utils.h"
+
+#define SUBADDRESS_EMPTY UINT32_MAX
+#define SUBADDRESS_BATCH 64
+#define SUBADDRESS_HASH_SIZE (8 + sizeof(secret_key) + sizeof(subaddress_index))
 
 subaddress_index generate_subaddress_index(uint32_t major, uint32_t minor) {
     subaddress_index idx;
@@ -8,27 +18,43 @@ subaddress_index generate_subaddress_index(uint32_t major, uint32_t minor) {
     return idx;
 }
 
+/* Absorb the part of m that is the same for every index of a, prefix || a
+ */
+void subaddress_getm_prefix(keccak_ctx* ctx, secret_key a) {
+    char prefix[] = "SubAddr";
+    keccak_init(ctx, HASH_SIZE);
+    keccak_update(ctx, (const uint8_t*) prefix, sizeof(prefix));
+    keccak_update(ctx, a, sizeof(secret_key));
+}
+
+/* m for index, continuing a copy of the state from subaddress_getm_prefix
+ */
+void subaddress_getm_from(ec_scalar m, const keccak_ctx* prefix, subaddress_index index) {
+    keccak_ctx ctx;
+    keccak_clone(&ctx, prefix);
+    keccak_update(&ctx, (const uint8_t*) &index, sizeof(subaddress_index));
+    hash_to_scalar_final(&ctx, m);
+}
+
 /* Generate the m value:
  *  m = H(prefix || a || major_i || minor_i)
  */
 void subaddress_getm(ec_scalar m, secret_key a, subaddress_index index) {
-    char prefix[] = "SubAddr";
-    int data_size = sizeof(prefix) + sizeof(secret_key) + sizeof(subaddress_index);
-    char data[data_size];
-    memcpy(data, prefix, sizeof(prefix));
-    memcpy(data+sizeof(prefix), a, sizeof(secret_key));
-    memcpy(data+sizeof(prefix)+sizeof(secret_key), &index, sizeof(subaddress_index));
-    hash_to_scalar(data, data_size, m);
+    keccak_ctx prefix;
+    subaddress_getm_prefix(&prefix, a);
+    subaddress_getm_from(m, &prefix, index);
 }
 
 /* Generate the public spend key, D, of a subaddress
  *  D = B + M
  */
 void subaddress_get_public_spend(public_key D, secret_key a, public_key B, subaddress_index index) {
-    ec_scalar m, M;
+    ec_scalar m;
+    prepared_point P;
     subaddress_getm(m, a, index);   //m = H(a || i)
-    scalarMultBase(M, m);           //M = m*G
-    addKeys(D, B, M);               //D = M + B
+    point_load(&P, B);
+    point_addMultBase(&P, m, &P);   //D = m*G + B
+    point_store(D, &P);
 }
 
 /* Sub-addresses are addresses that have different public view and spend keys,
@@ -40,8 +66,18 @@ void subaddress_get_public_spend(public_key D, secret_key a, public_key B, subad
  *  C = a*D
  */
 void generate_subaddress(public_key D, public_key C, public_key B, secret_key a, subaddress_index index) {
-    subaddress_get_public_spend(D,a,B,index);
-    scalarMult(C, a, D);            //C = a*D
+    ec_scalar m;
+    prepared_point DC[2];
+    ec_point out[2];
+
+    subaddress_getm(m, a, index);           //m = H(a || i)
+    point_load(&DC[0], B);
+    point_addMultBase(&DC[0], m, &DC[0]);   //D = m*G + B
+    point_scalarMult(&DC[1], a, &DC[0]);    //C = a*D
+
+    point_store_batch(out, DC, 2);          //One inversion for both keys
+    memcpy(D, out[0], 32);
+    memcpy(C, out[1], 32);
 }
 
 /* Retrieving the private key to stealth output is slightly different for subaddresses.
@@ -56,4 +92,302 @@ void subaddress_get_stealth_secret(secret_key sec, ec_scalar pre, secret_key a,
     ec_scalar m;
     subaddress_getm(m,a,index);
     sc_add(sec, pre, m);
-}
\ No newline at end of file
+}
+
+/* A slice of a generate_subaddress_range call, run on one thread */
+typedef struct subaddress_range_job {
+    const unsigned char* a;
+    const ge_p3* B;
+    uint32_t major, begin, end;
+    public_key* D;              //Indexed from the begin of the whole range
+    public_key* C;
+} subaddress_range_job;
+
+static void* subaddress_range_run(void* arg) {
+    const subaddress_range_job* job = arg;
+    const char prefix[] = "SubAddr";
+    unsigned char data[SUBADDRESS_BATCH][SUBADDRESS_HASH_SIZE];
+    ec_scalar m[SUBADDRESS_BATCH];
+    ge_p3 D3[SUBADDRESS_BATCH], C3[SUBADDRESS_BATCH];
+    ge_prepared_scalar pa;
+    ge_cached Bc;
+    ge_p1p1 t;
+    size_t i, n;
+
+    ge_p3_to_cached(&Bc, job->B);
+    if (job->C != NULL) {
+        ge_prepare_scalar(&pa, job->a);
+    }
+    //prefix || a is less than a block, so it is copied rather than absorbed
+    //once, and the whole inputs hashed four at a time
+    for (i = 0; i < SUBADDRESS_BATCH; i++) {
+        memcpy(data[i], prefix, sizeof(prefix));
+        memcpy(data[i] + sizeof(prefix), job->a, sizeof(secret_key));
+    }
+
+    for (uint32_t minor = job->begin; minor < job->end; minor += n) {
+        n = job->end - minor < SUBADDRESS_BATCH ? job->end - minor : SUBADDRESS_BATCH;
+        for (i = 0; i < n; i++) {
+            subaddress_index index = generate_subaddress_index(job->major, minor + i);
+            memcpy(data[i] + sizeof(prefix) + sizeof(secret_key), &index, sizeof(index));
+        }
+        hash_to_scalar_batch(data, SUBADDRESS_HASH_SIZE, n, m);         //m = H(a || i)
+        ge_scalarmult_base_batch(D3, (const unsigned char (*)[32]) m, n);
+        for (i = 0; i < n; i++) {
+            ge_add(&t, &D3[i], &Bc);                                    //D = m*G + B
+            ge_p1p1_to_p3(&D3[i], &t);
+        }
+        ge_p3_tobytes_batch(&job->D[minor - job->begin], D3, n);
+        if (job->C != NULL) {
+            ge_scalarmult_fixed_batch(C3, &pa, D3, n);                  //C = a*D
+            ge_p3_tobytes_batch(&job->C[minor - job->begin], C3, n);
+        }
+    }
+    memwipe(data, sizeof(data));
+    memwipe(m, sizeof(m));
+    memwipe(&pa, sizeof(pa));
+    return NULL;
+}
+
+bool generate_subaddress_range(secret_key a, public_key B, uint32_t major, uint32_t minor_begin, uint32_t minor_end, public_key* D, public_key* C, int threads) {
+    size_t n = minor_end > minor_begin ? minor_end - minor_begin : 0;
+    ge_p3 B3;
+
+    if (ge_frombytes_vartime(&B3, B) != 0) {
+        return false;
+    }
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if ((size_t) threads > n / SUBADDRESS_BATCH) {    //At least a batch each
+        threads = n / SUBADDRESS_BATCH;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    subaddress_range_job jobs[threads];
+    pthread_t ids[threads];
+    bool started[threads];
+    for (int i = 0; i < threads; i++) {
+        size_t begin = n * i / threads, end = n * (i + 1) / threads;
+        jobs[i].a = a;
+        jobs[i].B = &B3;
+        jobs[i].major = major;
+        jobs[i].begin = minor_begin + begin;
+        jobs[i].end = minor_begin + end;
+        jobs[i].D = D + begin;
+        jobs[i].C = C != NULL ? C + begin : NULL;
+    }
+    for (int i = 1; i < threads; i++) {
+        started[i] = pthread_create(&ids[i], NULL, subaddress_range_run, &jobs[i]) == 0;
+        if (!started[i]) {
+            subaddress_range_run(&jobs[i]);
+        }
+    }
+    subaddress_range_run(&jobs[0]);
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(ids[i], NULL);
+        }
+    }
+    return true;
+}
+
+//Keys are hashes of a secret, so their first bytes are already uniform
+static size_t subaddress_slot_of(const subaddress_table* t, const public_key D) {
+    uint64_t h;
+    memcpy(&h, D, 8);
+    return h & t->mask;
+}
+
+static void subaddress_insert(subaddress_slot* slots, size_t mask, const public_key D, subaddress_index index) {
+    uint64_t h;
+    size_t i;
+
+    memcpy(&h, D, 8);
+    for (i = h & mask; slots[i].index.major != SUBADDRESS_EMPTY; i = (i + 1) & mask);
+    memcpy(slots[i].D, D, 32);
+    slots[i].index = index;
+}
+
+//Add n keys, doubling the slots to stay at most half full. Write lock held
+static bool subaddress_table_add(subaddress_table* t, const public_key* D, const subaddress_index* indices, size_t n) {
+    size_t size = t->mask + 1;
+
+    if (t->slots == NULL || 2 * (t->count + n) > size) {
+        subaddress_slot* slots;
+        if (t->slots == NULL) {
+            size = 16;
+        }
+        while (2 * (t->count + n) > size) {
+            size *= 2;
+        }
+        slots = malloc(size * sizeof(subaddress_slot));
+        if (slots == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i < size; i++) {
+            slots[i].index.major = SUBADDRESS_EMPTY;
+        }
+        for (size_t i = 0; t->slots != NULL && i <= t->mask; i++) {
+            if (t->slots[i].index.major != SUBADDRESS_EMPTY) {
+                subaddress_insert(slots, size - 1, t->slots[i].D, t->slots[i].index);
+            }
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->mask = size - 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        subaddress_insert(t->slots, t->mask, D[i], indices[i]);
+    }
+    t->count += n;
+    return true;
+}
+
+bool subaddress_table_extend(subaddress_table* t, uint32_t majors, uint32_t minors) {
+    subaddress_index* indices;
+    public_key* D;
+    size_t n = 0;
+    bool res;
+
+    pthread_mutex_lock(&t->grow);
+    if (majors < t->majors) {
+        majors = t->majors;
+    }
+    if (minors < t->minors) {
+        minors = t->minors;
+    }
+    //The new indices: new minors of the old majors, then all of the new majors
+    n = (size_t) majors * minors - (size_t) t->majors * t->minors;
+    indices = malloc(n * sizeof(subaddress_index));
+    D = malloc(n * sizeof(public_key));
+    if (n > 0 && (indices == NULL || D == NULL)) {
+        free(indices);
+        free(D);
+        pthread_mutex_unlock(&t->grow);
+        return false;
+    }
+    //Lookups carry on while the keys are generated
+    n = 0;
+    res = true;
+    for (uint32_t i = 0; i < majors && res; i++) {
+        uint32_t begin = i < t->majors ? t->minors : 0;
+        res = generate_subaddress_range(t->a, t->B, i, begin, minors, &D[n], NULL, t->threads);
+        for (uint32_t j = begin; j < minors; j++) {
+            indices[n] = generate_subaddress_index(i, j);
+            if (i == 0 && j == 0) {
+                memcpy(D[n], t->B, 32);         //The main address
+            }
+            n++;
+        }
+    }
+
+    pthread_rwlock_wrlock(&t->lock);
+    res = res && subaddress_table_add(t, (const public_key*) D, indices, n);
+    if (res) {
+        t->majors = majors;
+        t->minors = minors;
+    }
+    pthread_rwlock_unlock(&t->lock);
+    pthread_mutex_unlock(&t->grow);
+
+    free(indices);
+    free(D);
+    return res;
+}
+
+bool subaddress_table_init(subaddress_table* t, secret_key a, public_key B, uint32_t majors, uint32_t minors, int threads) {
+    memset(t, 0, sizeof(*t));
+    memcpy(t->a, a, 32);
+    memcpy(t->B, B, 32);
+    t->look_majors = majors;
+    t->look_minors = minors;
+    t->threads = threads > 0 ? threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (t->threads < 1) {
+        t->threads = 1;
+    }
+    pthread_rwlock_init(&t->lock, NULL);
+    pthread_mutex_init(&t->grow, NULL);
+    if (!subaddress_table_extend(t, majors, minors)) {
+        subaddress_table_free(t);
+        return false;
+    }
+    return true;
+}
+
+void subaddress_table_free(subaddress_table* t) {
+    pthread_rwlock_destroy(&t->lock);
+    pthread_mutex_destroy(&t->grow);
+    free(t->slots);
+    memwipe(t, sizeof(*t));     //Holds a copy of the secret view key
+}
+
+bool subaddress_table_lookup(subaddress_table* t, const public_key D, subaddress_index* index) {
+    bool found = false;
+
+    pthread_rwlock_rdlock(&t->lock);
+    if (t->slots != NULL) {
+        for (size_t i = subaddress_slot_of(t, D); t->slots[i].index.major != SUBADDRESS_EMPTY; i = (i + 1) & t->mask) {
+            if (memcmp(t->slots[i].D, D, 32) == 0) {
+                *index = t->slots[i].index;
+                found = true;
+                break;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&t->lock);
+    return found;
+}
+
+bool subaddress_table_match(subaddress_table* t, const public_key D, subaddress_index* index) {
+    uint32_t majors, minors;
+
+    if (!subaddress_table_lookup(t, D, index)) {
+        return false;
+    }
+    pthread_rwlock_rdlock(&t->lock);
+    majors = t->majors;
+    minors = t->minors;
+    pthread_rwlock_unlock(&t->lock);
+    if (index->major + t->look_majors / 2 >= majors || index->minor + t->look_minors / 2 >= minors) {
+        subaddress_table_extend(t, index->major + t->look_majors, index->minor + t->look_minors);
+    }
+    return true;
+}
+
+int subaddress_scan_tx(bool* owned, ec_scalar* scalars, subaddress_index* indices, const public_key* pubs, const unsigned char* view_tags, size_t n, public_key R, subaddress_table* t) {
+    public_key* D = calloc(n > 0 ? n : 1, sizeof(public_key));
+    int found;
+
+    if (D == NULL) {
+        return -1;
+    }
+    found = scanStealthTx(owned, scalars, D, pubs, view_tags, n, R, t->a, t->B);
+    for (size_t i = 0; found >= 0 && i < n; i++) {
+        if (owned[i]) {
+            indices[i] = generate_subaddress_index(0, 0);
+        } else if (subaddress_table_match(t, D[i], &indices[i])) {
+            owned[i] = true;
+            found++;
+        }
+    }
+    free(D);
+    return found;
+}
+
+size_t subaddress_scan_txs(bool* owned, ec_scalar* scalars, subaddress_index* indices, const public_key* pubs, const unsigned char* view_tags, const size_t* counts, const public_key* R, size_t txs, subaddress_table* t) {
+    size_t found = 0, first = 0;
+
+    for (size_t k = 0; k < txs; k++) {
+        int res = subaddress_scan_tx(&owned[first], &scalars[first], &indices[first], &pubs[first], view_tags != NULL ? &view_tags[first] : NULL, counts[k], (unsigned char*) R[k], t);
+        if (res > 0) {
+            found += res;
+        } else if (res < 0) {
+            memset(&owned[first], 0, counts[k] * sizeof(bool));
+        }
+        first += counts[k];
+    }
+    return found;
+}
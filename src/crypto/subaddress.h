@@ -1,9 +1,12 @@
 #ifndef SUBADDRESS_H
 #define SUBADDRESS_H
 
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "keys.h"
+#include "./hash/hash.h"
 
 typedef struct subaddress_index {
     uint32_t major;
@@ -21,12 +24,94 @@ void generate_subaddress(public_key D, public_key C, public_key B, secret_key a,
  */
 void subaddress_getm(ec_scalar m, secret_key a, subaddress_index index);
 
+/* subaddress_getm for many indices of one a: absorb prefix || a once with
+ * subaddress_getm_prefix, then get the m of each index with subaddress_getm_from
+ */
+void subaddress_getm_prefix(keccak_ctx* ctx, secret_key a);
+void subaddress_getm_from(ec_scalar m, const keccak_ctx* prefix, subaddress_index index);
+
 void subaddress_get_public_spend(public_key D, secret_key a, public_key B, subaddress_index index);
 
+/* generate_subaddress for the indices (major, minor_begin) up to but not
+ * including (major, minor_end): D[i] and C[i] are the keys of minor_begin + i.
+ * C may be NULL when only the spend keys are needed (see subaddress_table).
+ * Keys are made in batches, on threads threads (0 for one per CPU). Returns
+ * false if B is not a valid point
+ */
+bool generate_subaddress_range(secret_key a, public_key B, uint32_t major, uint32_t minor_begin, uint32_t minor_end, public_key* D, public_key* C, int threads);
+
 /* Get the secret key to a one-time key destined for a subaddress.
  *      pre holds the value from getStealthKey()    H(aR) + b
  *  sec = pre + m
  */
 void subaddress_get_stealth_secret(secret_key sec, ec_scalar pre, secret_key a, subaddress_index index);
 
+    /* ======================================== */
+    /*        Subaddress spend key lookup        */
+    /* ======================================== */
+
+/* Maps the public spend key D of each subaddress of (a,B) in a window of
+ * majors x minors indices back to its index, so that the D returned by
+ * isStealthMine or scanStealthTx can be matched without trying every
+ * subaddress. (0,0) maps the main spend key B itself.
+ *
+ * Keys are kept in an open-addressed table of 40-byte slots. Lookups are safe
+ * from any number of threads, including while the window grows; init and free
+ * are not. The fields are private to subaddress.c.
+ */
+typedef struct subaddress_slot {
+    public_key D;
+    subaddress_index index;     //major is SUBADDRESS_EMPTY in unused slots
+} subaddress_slot;
+
+typedef struct subaddress_table {
+    subaddress_slot* slots;
+    size_t mask;                //Number of slots - 1
+    size_t count;
+    uint32_t majors, minors;    //Window of indices in the table
+    uint32_t look_majors, look_minors;
+    int threads;
+    secret_key a;
+    public_key B;
+    pthread_rwlock_t lock;      //Held for writing while slots change
+    pthread_mutex_t grow;       //One window change at a time
+} subaddress_table;
+
+/* Fill t with the majors x minors window of subaddresses of (a,B), using
+ * threads threads (0 for one per CPU). The initial window is also the
+ * lookahead that subaddress_table_match keeps past the highest index used.
+ * Returns false if memory could not be allocated
+ */
+bool subaddress_table_init(subaddress_table* t, secret_key a, public_key B, uint32_t majors, uint32_t minors, int threads);
+void subaddress_table_free(subaddress_table* t);
+
+//True, with the index, if D is the spend key of a subaddress in the table
+bool subaddress_table_lookup(subaddress_table* t, const public_key D, subaddress_index* index);
+
+//Grow the window to at least majors x minors, adding the new subaddresses
+bool subaddress_table_extend(subaddress_table* t, uint32_t majors, uint32_t minors);
+
+/* subaddress_table_lookup, growing the window when the match is less than
+ * half a lookahead from its edge
+ */
+bool subaddress_table_match(subaddress_table* t, const public_key D, subaddress_index* index);
+
+/* scanStealthTx for all subaddresses in t: owned[i] is set if pubs[i] goes to
+ * any of them, and then indices[i] is the subaddress. scalars[i] is H(aR || i)
+ * for getStealthKeyFromScalar and subaddress_get_stealth_secret. view_tags is
+ * NULL or the view tags of the outputs, and scalars[i] is only set for outputs
+ * that pass their tag. Returns the number of owned outputs, or -1 if R is not
+ * a valid point
+ */
+int subaddress_scan_tx(bool* owned, ec_scalar* scalars, subaddress_index* indices, const public_key* pubs, const unsigned char* view_tags, size_t n, public_key R, subaddress_table* t);
+
+/* subaddress_scan_tx of txs transactions in one call. The outputs of all of
+ * them are back to back in pubs, counts[k] of them for transaction k with
+ * public key R[k], and view_tags (if not NULL), owned, scalars and indices
+ * are laid out the same way.
+ * A transaction with an invalid R owns nothing. Returns the number of owned
+ * outputs
+ */
+size_t subaddress_scan_txs(bool* owned, ec_scalar* scalars, subaddress_index* indices, const public_key* pubs, const unsigned char* view_tags, const size_t* counts, const public_key* R, size_t txs, subaddress_table* t);
+
 #endif
\ No newline at end of file
@@ -33,4 +33,6 @@ func main() {
 	//serialTest()
 	TestVerRange()
 	TestRange()
+	//scannerTest()
+	//storeTest()
 }
@@ -0,0 +1,261 @@
+package main
+
+/*
+#cgo LDFLAGS: -L ../lib -lmonerocrypto
+#include <stdlib.h>
+#include "./crypto/keys.h"
+#include "./crypto/stealth.h"
+#include "./crypto/subaddress.h"
+*/
+import "C"
+
+import (
+	"errors"
+	"fmt"
+	"runtime"
+	"unsafe"
+)
+
+//ScanTx is a transaction to scan: its public key and the keys of its outputs.
+//ViewTags holds the view tags of the outputs if the transaction has them.
+type ScanTx struct {
+	Height   uint64
+	TxPub    Key
+	Outputs  []Key
+	ViewTags []byte
+}
+
+//ScanMatch is an output of a scanned transaction that belongs to the wallet
+type ScanMatch struct {
+	Height     uint64
+	TxPub      Key
+	Index      int    //Output index in the transaction
+	Dest       Key    //One-time public key of the output
+	Major      uint32 //Subaddress the output was sent to, 0/0 for the main address
+	Minor      uint32
+	Derivation Scalar //H(aR || Index), see OutputSecret
+}
+
+//Scanner finds the outputs of a wallet and its subaddresses in a stream of
+//transactions. The transactions are cut into batches of BatchSize, each
+//scanned by one of Workers goroutines with a single cgo call.
+type Scanner struct {
+	Workers   int
+	BatchSize int
+	table     *C.subaddress_table
+}
+
+//scanJob is a batch of transactions and where its matches go
+type scanJob struct {
+	txs    []ScanTx
+	result chan []ScanMatch
+}
+
+//NewScanner returns a Scanner for the keys in ring and the subaddresses in the
+//majors x minors window, which grows as subaddresses near its edge are found.
+//workers <= 0 uses one worker per CPU. Close frees the subaddress table.
+func NewScanner(ring KeyRing, majors, minors uint32, workers int) (*Scanner, error) {
+	if workers <= 0 {
+		workers = runtime.NumCPU()
+	}
+	s := &Scanner{Workers: workers, BatchSize: 64}
+	s.table = (*C.subaddress_table)(C.malloc(C.sizeof_subaddress_table))
+	if s.table == nil {
+		return nil, errors.New("could not allocate the subaddress table")
+	}
+	if !C.subaddress_table_init(s.table, GoKeyToUcharPtr(&ring.skView), GoKeyToUcharPtr(&ring.pkSpend), C.uint32_t(majors), C.uint32_t(minors), C.int(workers)) {
+		C.free(unsafe.Pointer(s.table))
+		s.table = nil
+		return nil, errors.New("could not build the subaddress table")
+	}
+	return s, nil
+}
+
+//Close frees the subaddress table. The scanner must not be used afterwards.
+func (s *Scanner) Close() {
+	if s.table != nil {
+		C.subaddress_table_free(s.table)
+		C.free(unsafe.Pointer(s.table))
+		s.table = nil
+	}
+}
+
+//Scan scans the transactions read from txs until it is closed, and returns
+//the owned outputs in the order of their transactions. The returned channel
+//is closed after the last match. A slow reader holds up scanning, and with it
+//reading from txs, once a few batches are waiting.
+func (s *Scanner) Scan(txs <-chan ScanTx) <-chan ScanMatch {
+	out := make(chan ScanMatch, s.BatchSize)
+	jobs := make(chan scanJob)
+	pending := make(chan chan []ScanMatch, 2*s.Workers) //Batches in flight, in input order
+
+	for i := 0; i < s.Workers; i++ {
+		go func() {
+			for job := range jobs {
+				job.result <- s.scanBatch(job.txs)
+			}
+		}()
+	}
+
+	go func() {
+		defer close(jobs)
+		defer close(pending)
+		batch := make([]ScanTx, 0, s.BatchSize)
+		for tx := range txs {
+			batch = append(batch, tx)
+			if len(batch) == s.BatchSize {
+				s.dispatch(batch, jobs, pending)
+				batch = make([]ScanTx, 0, s.BatchSize)
+			}
+		}
+		if len(batch) > 0 {
+			s.dispatch(batch, jobs, pending)
+		}
+	}()
+
+	go func() {
+		defer close(out)
+		for result := range pending {
+			for _, match := range <-result {
+				out <- match
+			}
+		}
+	}()
+	return out
+}
+
+//dispatch queues the result of batch for output before handing it to a worker
+func (s *Scanner) dispatch(batch []ScanTx, jobs chan<- scanJob, pending chan<- chan []ScanMatch) {
+	result := make(chan []ScanMatch, 1)
+	pending <- result
+	jobs <- scanJob{batch, result}
+}
+
+//scanBatch scans all outputs of the transactions in batch in one cgo call.
+//View tags are checked when every transaction of the batch has them.
+func (s *Scanner) scanBatch(batch []ScanTx) []ScanMatch {
+	n := 0
+	tagged := true
+	for _, tx := range batch {
+		n += len(tx.Outputs)
+		tagged = tagged && len(tx.ViewTags) == len(tx.Outputs)
+	}
+	if n == 0 {
+		return nil
+	}
+
+	pubs := make([]Key, 0, n)
+	counts := make([]C.size_t, len(batch))
+	txPubs := make([]Key, len(batch))
+	for k, tx := range batch {
+		pubs = append(pubs, tx.Outputs...)
+		counts[k] = C.size_t(len(tx.Outputs))
+		txPubs[k] = tx.TxPub
+	}
+	var viewTags *C.uchar
+	if tagged {
+		tags := make([]byte, 0, n)
+		for _, tx := range batch {
+			tags = append(tags, tx.ViewTags...)
+		}
+		viewTags = (*C.uchar)(unsafe.Pointer(&tags[0]))
+	}
+	owned := make([]C.bool, n)
+	derivations := make([]Scalar, n)
+	indices := make([]C.subaddress_index, n)
+
+	found := C.subaddress_scan_txs(&owned[0], GoKeyToCScalar(&derivations[0]), &indices[0], GoKeyToCPublicKey(&pubs[0]), viewTags, &counts[0], GoKeyToCPublicKey(&txPubs[0]), C.size_t(len(batch)), s.table)
+	if found == 0 {
+		return nil
+	}
+
+	matches := make([]ScanMatch, 0, int(found))
+	first := 0
+	for _, tx := range batch {
+		for i := range tx.Outputs {
+			if owned[first+i] {
+				matches = append(matches, ScanMatch{
+					Height:     tx.Height,
+					TxPub:      tx.TxPub,
+					Index:      i,
+					Dest:       tx.Outputs[i],
+					Major:      uint32(indices[first+i].major),
+					Minor:      uint32(indices[first+i].minor),
+					Derivation: derivations[first+i],
+				})
+			}
+		}
+		first += len(tx.Outputs)
+	}
+	return matches
+}
+
+//OutputSecret returns the one-time secret key of an output found by a Scanner
+//for the keys in ring
+func OutputSecret(ring KeyRing, match ScanMatch) Key {
+	var pre, priv Key
+	C.getStealthKeyFromScalar(GoKeyToUcharPtr(&pre), GoScalarToUcharPtr(&match.Derivation), GoKeyToUcharPtr(&ring.skSpend))
+	if match.Major == 0 && match.Minor == 0 {
+		return pre
+	}
+	index := C.generate_subaddress_index(C.uint32_t(match.Major), C.uint32_t(match.Minor))
+	C.subaddress_get_stealth_secret(GoKeyToUcharPtr(&priv), GoKeyToUcharPtr(&pre), GoKeyToUcharPtr(&ring.skView), index)
+	return priv
+}
+
+func scannerTest() {
+	fmt.Println("===Scanner test===")
+	ring := GenKeys()
+	other := GenKeys()
+	scanner, err := NewScanner(ring, 2, 20, 4)
+	if err != nil {
+		fmt.Println(err)
+		return
+	}
+	defer scanner.Close()
+
+	//Every third transaction pays output 1 to the wallet, alternating between
+	//the main address and subaddress (1, 7)
+	var subSpend, subView Key
+	C.generate_subaddress(GoKeyToUcharPtr(&subSpend), GoKeyToUcharPtr(&subView), GoKeyToUcharPtr(&ring.pkSpend), GoKeyToUcharPtr(&ring.skView), C.generate_subaddress_index(1, 7))
+
+	txs := make(chan ScanTx)
+	go func() {
+		for h := 0; h < 300; h++ {
+			var stealth C.stealth_address
+			tx := ScanTx{Height: uint64(h), Outputs: make([]Key, 3), ViewTags: make([]byte, 3)}
+			for i := range tx.Outputs {
+				C.generateStealthViewTag(GoKeyToUcharPtr(&other.pkView), GoKeyToUcharPtr(&other.pkSpend), &stealth, i == 0, C.size_t(i), false)
+				tx.Outputs[i] = *(*Key)(unsafe.Pointer(&stealth.pub))
+				tx.ViewTags[i] = byte(stealth.view_tag)
+			}
+			if h%3 == 0 {
+				if h%2 == 0 {
+					C.generateStealthViewTag(GoKeyToUcharPtr(&ring.pkView), GoKeyToUcharPtr(&ring.pkSpend), &stealth, false, 1, false)
+				} else {
+					C.generateStealthViewTag(GoKeyToUcharPtr(&subView), GoKeyToUcharPtr(&subSpend), &stealth, false, 1, true)
+				}
+				tx.Outputs[1] = *(*Key)(unsafe.Pointer(&stealth.pub))
+				tx.ViewTags[1] = byte(stealth.view_tag)
+			}
+			if h >= 150 {
+				tx.ViewTags = nil //The second half without view tags
+			}
+			tx.TxPub = *(*Key)(unsafe.Pointer(&stealth.R)) //rG, or rD to the subaddress
+			txs <- tx
+		}
+		close(txs)
+	}()
+
+	found, ok := 0, true
+	last := uint64(0)
+	for match := range scanner.Scan(txs) {
+		var pub Key
+		priv := OutputSecret(ring, match)
+		C.secret_to_public(GoKeyToUcharPtr(&pub), GoKeyToUcharPtr(&priv))
+		ok = ok && pub == match.Dest && match.Height%3 == 0 && match.Index == 1 && match.Height >= last
+		last = match.Height
+		found++
+	}
+	fmt.Printf("Found %d of 100 outputs, in order with their keys: %t\n", found, ok && found == 100)
+}
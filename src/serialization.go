@@ -29,6 +29,10 @@ import (
 
 func (in *TxOut) MarshallJSON() ([]byte, error) {
 	in.Target.DestString = hex.EncodeToString(in.Target.Dest[:])
+	in.Target.ViewTagString = ""
+	if in.Target.HasViewTag {
+		in.Target.ViewTagString = hex.EncodeToString([]byte{in.Target.ViewTag})
+	}
 	return json.MarshalIndent(in, "", "\t")
 }
 
@@ -36,6 +40,11 @@ func (in *TxOut) UnmarshallJSON(data []byte) error {
 	err := json.Unmarshal(data, in)
 	temp, _ := hex.DecodeString(in.Target.DestString)
 	copy(in.Target.Dest[:], temp[:])
+	tag, _ := hex.DecodeString(in.Target.ViewTagString)
+	in.Target.HasViewTag = len(tag) == 1
+	if in.Target.HasViewTag {
+		in.Target.ViewTag = tag[0]
+	}
 	return err
 }
 
@@ -212,8 +221,14 @@ func (prefix TransactionPrefix) SerializeTx() string {
 		C.write_varint(C.CString(temp), C.ulong(output.Amount))
 		buffer.WriteString(temp)
 
-		buffer.WriteByte(0x02) //txout_to_key is 02
-		buffer.WriteString(string(output.Target.Dest[:]))
+		if output.Target.HasViewTag {
+			buffer.WriteByte(0x03) //txout_to_tagged_key is 03
+			buffer.WriteString(string(output.Target.Dest[:]))
+			buffer.WriteByte(output.Target.ViewTag)
+		} else {
+			buffer.WriteByte(0x02) //txout_to_key is 02
+			buffer.WriteString(string(output.Target.Dest[:]))
+		}
 	}
 
 	//Prepend the extra byte length
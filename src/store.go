@@ -0,0 +1,398 @@
+package main
+
+import (
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"os"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+//A store file is one header page followed by fixed-width StoredOutput records.
+//The header holds two checkpoint slots in separate sectors, written in turn.
+//A checkpoint is only written once the records it covers are on disk, so after
+//a crash the newest slot with a good checksum describes a consistent store and
+//anything appended after it is ignored. Records are kept in the host's byte
+//order and read straight from the mapping, so opening costs the same for any
+//number of outputs.
+const (
+	storeMagic       = "GONEROST"
+	storeVersion     = 1
+	storePage        = 4096
+	storeSlotSize    = 512
+	storeInitRecords = 1024
+)
+
+//Flags of a StoredOutput
+const (
+	StoreSpent uint32 = 1 << iota
+)
+
+//StoredOutput is an owned output as kept in a Store
+type StoredOutput struct {
+	Dest     Key //One-time public key
+	TxPub    Key
+	KeyImage Key
+	Mask     Key //Decoded commitment mask
+	Amount   uint64
+	Height   uint64
+	Index    uint32 //Output index in the transaction
+	Major    uint32
+	Minor    uint32
+	Flags    uint32
+}
+
+const storeRecordSize = int(unsafe.Sizeof(StoredOutput{}))
+
+//storeCheckpoint is a header slot, Sum covers the fields before it
+type storeCheckpoint struct {
+	Magic    [8]byte
+	Version  uint32
+	Record   uint32 //Record size, a changed layout is not read as the old one
+	Sequence uint64
+	Height   uint64 //Scan height
+	Count    uint64 //Committed records
+	Sum      uint32
+	_        uint32
+}
+
+const storeSumSize = int(unsafe.Offsetof(storeCheckpoint{}.Sum))
+
+//Store keeps the scan height and owned outputs of a wallet in a memory-mapped
+//file. Appends and MarkSpent become durable at the next Checkpoint.
+//A Store is not safe for concurrent use, and the file is locked against other
+//processes while it is open.
+type Store struct {
+	file     *os.File
+	data     []byte
+	records  []StoredOutput //View of data after the header page
+	count    int            //Records including the ones not yet checkpointed
+	height   uint64
+	sequence uint64
+	pending  map[int]uint32 //Flags set since the last Checkpoint, by output
+}
+
+//NewStoredOutput returns the record for an output found by a Scanner, with the
+//amount and mask decoded from its ecdh info and its key image
+func NewStoredOutput(match ScanMatch, amount uint64, mask, keyImage Key) StoredOutput {
+	return StoredOutput{
+		Dest:     match.Dest,
+		TxPub:    match.TxPub,
+		KeyImage: keyImage,
+		Mask:     mask,
+		Amount:   amount,
+		Height:   match.Height,
+		Index:    uint32(match.Index),
+		Major:    match.Major,
+		Minor:    match.Minor,
+	}
+}
+
+//OpenStore opens the store at path, creating it if it does not exist. Only the
+//header is read, the outputs are paged in as they are used.
+func OpenStore(path string) (*Store, error) {
+	file, err := os.OpenFile(path, os.O_RDWR|os.O_CREATE, 0600)
+	if err != nil {
+		return nil, err
+	}
+	s := &Store{file: file, pending: make(map[int]uint32)}
+	if err = s.open(); err != nil {
+		s.Close()
+		return nil, err
+	}
+	return s, nil
+}
+
+func (s *Store) open() error {
+	if err := syscall.Flock(int(s.file.Fd()), syscall.LOCK_EX|syscall.LOCK_NB); err != nil {
+		return fmt.Errorf("store is in use: %v", err)
+	}
+	info, err := s.file.Stat()
+	if err != nil {
+		return err
+	}
+	//A new store is only the header page until its first checkpoint is on
+	//disk, the records are added by Append
+	size := info.Size()
+	if size == 0 {
+		size = storePage
+		if err = s.file.Truncate(size); err != nil {
+			return err
+		}
+	}
+	if size < storePage {
+		return errors.New("store is truncated")
+	}
+	if err = s.mmap(size); err != nil {
+		return err
+	}
+
+	cp, ok := s.latestCheckpoint()
+	if !ok {
+		//The first checkpoint goes to slot(1) and the second to slot(2). With
+		//neither valid and slot(2) never written, the first one did not
+		//complete, so nothing was committed and the store starts over.
+		if *s.slot(2) != (storeCheckpoint{}) {
+			return errors.New("store has no valid checkpoint")
+		}
+		return s.writeCheckpoint()
+	}
+	if cp.Count > uint64(len(s.records)) {
+		return errors.New("store is truncated")
+	}
+	s.count = int(cp.Count)
+	s.height = cp.Height
+	s.sequence = cp.Sequence
+	return nil
+}
+
+//mmap maps the first size bytes of the file, replacing any earlier mapping
+func (s *Store) mmap(size int64) error {
+	if s.data != nil {
+		if err := syscall.Munmap(s.data); err != nil {
+			return err
+		}
+		s.data, s.records = nil, nil
+	}
+	data, err := syscall.Mmap(int(s.file.Fd()), 0, int(size), syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED)
+	if err != nil {
+		return err
+	}
+	s.data = data
+	if n := (len(data) - storePage) / storeRecordSize; n > 0 {
+		s.records = unsafe.Slice((*StoredOutput)(unsafe.Pointer(&data[storePage])), n)
+	}
+	return nil
+}
+
+func (s *Store) slot(i uint64) *storeCheckpoint {
+	return (*storeCheckpoint)(unsafe.Pointer(&s.data[(i%2)*storeSlotSize]))
+}
+
+func checkpointSum(cp *storeCheckpoint) uint32 {
+	return crc32.ChecksumIEEE(unsafe.Slice((*byte)(unsafe.Pointer(cp)), storeSumSize))
+}
+
+//latestCheckpoint returns the newest header slot that is intact
+func (s *Store) latestCheckpoint() (cp storeCheckpoint, ok bool) {
+	for i := uint64(0); i < 2; i++ {
+		c := *s.slot(i)
+		if string(c.Magic[:]) != storeMagic || c.Version != storeVersion ||
+			c.Record != uint32(storeRecordSize) || c.Sum != checkpointSum(&c) {
+			continue
+		}
+		if !ok || c.Sequence > cp.Sequence {
+			cp, ok = c, true
+		}
+	}
+	return cp, ok
+}
+
+//writeCheckpoint records the current height and count in the older slot
+func (s *Store) writeCheckpoint() error {
+	var cp storeCheckpoint
+	copy(cp.Magic[:], storeMagic)
+	cp.Version = storeVersion
+	cp.Record = uint32(storeRecordSize)
+	cp.Sequence = s.sequence + 1
+	cp.Height = s.height
+	cp.Count = uint64(s.count)
+	cp.Sum = checkpointSum(&cp)
+
+	*s.slot(cp.Sequence) = cp
+	if err := msync(s.data[:storePage]); err != nil {
+		return err
+	}
+	s.sequence = cp.Sequence
+	return nil
+}
+
+//msync writes the dirty pages of b, which must start on a page, to disk
+func msync(b []byte) error {
+	if len(b) == 0 {
+		return nil
+	}
+	_, _, errno := syscall.Syscall(syscall.SYS_MSYNC, uintptr(unsafe.Pointer(&b[0])), uintptr(len(b)), syscall.MS_SYNC)
+	if errno != 0 {
+		return errno
+	}
+	return nil
+}
+
+//Height returns the scan height of the last Checkpoint
+func (s *Store) Height() uint64 {
+	return s.height
+}
+
+//Len returns the number of outputs, including the ones not yet checkpointed
+func (s *Store) Len() int {
+	return s.count
+}
+
+//Outputs returns the outputs in the order they were appended. The slice points
+//into the mapping, so it is for reading only and must not be used after the
+//next Append or Close. Flags set by MarkSpent only show in it after
+//the next Checkpoint, see Spent.
+func (s *Store) Outputs() []StoredOutput {
+	return s.records[:s.count]
+}
+
+//Append adds outputs to the store, growing the file as needed
+func (s *Store) Append(outputs ...StoredOutput) error {
+	if need := s.count + len(outputs); need > len(s.records) {
+		capacity := 2 * len(s.records)
+		if capacity < storeInitRecords {
+			capacity = storeInitRecords
+		}
+		if capacity < need {
+			capacity = need
+		}
+		size := int64(storePage + capacity*storeRecordSize)
+		if err := s.file.Truncate(size); err != nil {
+			return err
+		}
+		if err := s.mmap(size); err != nil {
+			return err
+		}
+	}
+	s.count += copy(s.records[s.count:], outputs)
+	return nil
+}
+
+//MarkSpent flags output i as spent. The flag is kept in memory and written to
+//the mapping by the next Checkpoint.
+func (s *Store) MarkSpent(i int) {
+	s.pending[i] |= StoreSpent
+}
+
+//Spent returns whether output i is spent, including MarkSpent calls since the
+//last Checkpoint
+func (s *Store) Spent(i int) bool {
+	return (s.records[i].Flags|s.pending[i])&StoreSpent != 0
+}
+
+//Checkpoint makes the outputs appended and marked spent so far durable
+//together with scan height. If it fails, or the process stops before it
+//returns, the store reopens at the previous checkpoint with its outputs.
+//Flags are changed in place, so some of the new ones may already be on disk
+//then. That is harmless: they only record spends at or after the previous
+//height, and scanning again from it marks the same outputs.
+func (s *Store) Checkpoint(height uint64) error {
+	for i, flags := range s.pending {
+		s.records[i].Flags |= flags
+	}
+	if err := msync(s.data[storePage : storePage+s.count*storeRecordSize]); err != nil {
+		return err
+	}
+	previous := s.height
+	s.height = height
+	if err := s.writeCheckpoint(); err != nil {
+		s.height = previous
+		return err
+	}
+	s.pending = make(map[int]uint32)
+	return nil
+}
+
+//Close unmaps and closes the store. Outputs appended and marked spent since the
+//last Checkpoint are dropped.
+func (s *Store) Close() error {
+	var err error
+	if s.data != nil {
+		err = syscall.Munmap(s.data)
+		s.data, s.records = nil, nil
+	}
+	if cerr := s.file.Close(); err == nil {
+		err = cerr
+	}
+	return err
+}
+
+func storeTest() {
+	fmt.Println("===Store test===")
+	dir, err := os.MkdirTemp("", "gonero")
+	if err != nil {
+		fmt.Println(err)
+		return
+	}
+	defer os.RemoveAll(dir)
+	path := dir + "/wallet.store"
+
+	if err = storeFill(path, 200000); err != nil {
+		fmt.Println(err)
+		return
+	}
+
+	start := time.Now()
+	s, err := OpenStore(path)
+	if err != nil {
+		fmt.Println(err)
+		return
+	}
+	elapsed := time.Since(start)
+	outputs := s.Outputs()
+	ok := s.Len() == 200000 && s.Height() == 50000 && s.Spent(7) && !s.Spent(8)
+	for i := 0; ok && i < s.Len(); i++ {
+		ok = outputs[i].Amount == uint64(i) && outputs[i].Dest[2] == byte(i>>16)
+	}
+	fmt.Printf("Reopened %d outputs in %v: %t\n", s.Len(), elapsed, ok)
+
+	//A torn write of the newest checkpoint falls back to the one before
+	s.slot(s.sequence).Sum++
+	s.Close()
+	s, err = OpenStore(path)
+	if err != nil {
+		fmt.Println(err)
+		return
+	}
+	fmt.Printf("Recovered from a torn checkpoint: %t\n", s.Len() == 196000 && s.Height() == 49000)
+	s.Close()
+
+	//A process that stopped while creating the store leaves a zeroed header
+	path = dir + "/new.store"
+	if err = os.WriteFile(path, make([]byte, storePage), 0600); err != nil {
+		fmt.Println(err)
+		return
+	}
+	s, err = OpenStore(path)
+	if err != nil {
+		fmt.Println(err)
+		return
+	}
+	fmt.Printf("Recovered from an interrupted create: %t\n", s.Len() == 0 && s.Height() == 0)
+	s.Close()
+}
+
+//storeFill creates a store at path with n outputs, four per block and
+//checkpointed every 1000 blocks, then adds changes that are never checkpointed
+func storeFill(path string, n int) error {
+	s, err := OpenStore(path)
+	if err != nil {
+		return err
+	}
+	defer s.Close()
+
+	var out StoredOutput
+	for i := 0; i < n; i++ {
+		out.Height = uint64(i / 4)
+		out.Amount = uint64(i)
+		out.Index = uint32(i % 4)
+		out.Dest[0], out.Dest[1], out.Dest[2] = byte(i), byte(i>>8), byte(i>>16)
+		if err = s.Append(out); err != nil {
+			return err
+		}
+		if i%4000 == 3999 && i != n-1 {
+			if err = s.Checkpoint(out.Height + 1); err != nil {
+				return err
+			}
+		}
+	}
+	s.MarkSpent(7)
+	if err = s.Checkpoint(uint64(n / 4)); err != nil {
+		return err
+	}
+	s.MarkSpent(8)
+	return s.Append(StoredOutput{Amount: 1})
+}
@@ -36,9 +36,14 @@ type TxInToKey struct {
 
 //TxOutToKey holds the key for the destination of this output
 //Currently this is the only supported output type
+//With HasViewTag it is a txout_to_tagged_key, which also carries the view tag
+//of the output (see stealth_address) so scanners can skip most outputs early
 type TxOutToKey struct {
-	Dest       Key    `json:"-"`
-	DestString string `json:"key"`
+	Dest          Key    `json:"-"`
+	DestString    string `json:"key"`
+	HasViewTag    bool   `json:"-"`
+	ViewTag       byte   `json:"-"`
+	ViewTagString string `json:"view_tag,omitempty"`
 }
 
 //TxOut holds the information for a tx output: the amount (0 for rct) and the target
@@ -1,5 +1,6 @@
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "utils.h"
 
@@ -47,4 +48,12 @@ size_t write_varint(char* dest, size_t i) {
     dest++;			/* Seems kinda pointless... */
     size ++;
     return size;
-}
\ No newline at end of file
+}
+
+//Called through a volatile pointer, so the compiler cannot see that it is
+//memset and drop it when the buffer is not read again
+static void* (*volatile memwipe_memset)(void*, int, size_t) = memset;
+
+void memwipe(void* p, size_t n) {
+    memwipe_memset(p, 0, n);
+}
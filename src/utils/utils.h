@@ -11,4 +11,7 @@ bool isByteArraysEqual(char* s1, char* s2, int n);
 
 size_t write_varint(char* dest, size_t i);
 
+//Zero n bytes of secret data, not removed as a dead store by the compiler
+void memwipe(void* p, size_t n);
+
 #endif
\ No newline at end of file
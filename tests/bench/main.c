@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../../src/crypto/keys.h"
+#include "../../src/crypto/random.h"
+#include "../../src/crypto/crypto_math/crypto-ops.h"
+
+#define ITERATIONS 2000
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+//Microseconds per ge_scalarmult_base with the current table, best of 5 runs
+double bench_scalarmult_base(unsigned char (*a)[32]) {
+    double best = 1e9;
+    ge_p3 r;
+
+    for (size_t run = 0; run < 5; run++) {
+        double start = now();
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            ge_scalarmult_base(&r, a[i]);
+        }
+        double t = (now() - start) / ITERATIONS * 1e6;
+        if (t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+//Compare the current table against ge_base
+bool check_scalarmult_base(unsigned char (*a)[32], unsigned char (*expected)[32]) {
+    ge_p3 r;
+    unsigned char out[32];
+
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        ge_scalarmult_base(&r, a[i]);
+        ge_p3_tobytes(out, &r);
+        if (memcmp(out, expected[i], 32) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Speed against table size of the ge_scalarmult_base windows, and the time
+ * to generate each table
+ */
+void bench_base_tables() {
+    unsigned char (*a)[32] = malloc(ITERATIONS * 32);
+    unsigned char (*expected)[32] = malloc(ITERATIONS * 32);
+    unsigned char wide[64];
+    ge_p3 r;
+
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        gen_random_bytes(64, wide);
+        sc_reduce(wide);
+        memcpy(a[i], wide, 32);
+        ge_scalarmult_base(&r, a[i]);
+        ge_p3_tobytes(expected[i], &r);
+    }
+
+    printf("window   table KiB   generate ms   us/mult   check\n");
+    printf("ge_base  %9.1f   %11s   %7.2f   %s\n", ge_scalarmult_base_table_size(0) / 1024.0,
+        "-", bench_scalarmult_base(a), "ok");
+
+    for (int w = 4; w <= 12; w++) {
+        double start = now();
+        if (ge_scalarmult_base_init(w) != 0) {
+            printf("%-7d  init failed\n", w);
+            continue;
+        }
+        double generate = now() - start;
+
+        bool ok = check_scalarmult_base(a, expected);
+        printf("%-7d  %9.1f   %11.1f   %7.2f   %s\n", w, ge_scalarmult_base_table_size(w) / 1024.0,
+            generate * 1e3, bench_scalarmult_base(a), ok ? "ok" : "FAILED");
+    }
+
+    ge_scalarmult_base_init(0);
+    free(a);
+    free(expected);
+}
+
+//Microseconds per a*A + b*B with the current table of B, best of 5 runs
+double bench_double_scalarmult(unsigned char (*a)[32], ge_p3* A, unsigned char (*b)[32]) {
+    double best = 1e9;
+    ge_p2 r;
+
+    for (size_t run = 0; run < 5; run++) {
+        double start = now();
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            ge_double_scalarmult_base_vartime(&r, a[i], &A[i], b[i]);
+        }
+        double t = (now() - start) / ITERATIONS * 1e6;
+        if (t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+bool check_double_scalarmult(unsigned char (*a)[32], ge_p3* A, unsigned char (*b)[32], unsigned char (*expected)[32]) {
+    ge_p2 r;
+    unsigned char out[32];
+
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        ge_double_scalarmult_base_vartime(&r, a[i], &A[i], b[i]);
+        ge_tobytes(out, &r);
+        if (memcmp(out, expected[i], 32) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Speed against table size of the B tables of the vartime double scalar
+ * multiplication (calc_LR, addKeys_double_multBase)
+ */
+void bench_vartime_tables() {
+    unsigned char (*a)[32] = malloc(ITERATIONS * 32);
+    unsigned char (*b)[32] = malloc(ITERATIONS * 32);
+    unsigned char (*expected)[32] = malloc(ITERATIONS * 32);
+    ge_p3* A = malloc(ITERATIONS * sizeof(ge_p3));
+    unsigned char wide[64];
+    ge_p2 r;
+
+    for (size_t i = 0; i < ITERATIONS; i++) {
+        gen_random_bytes(64, wide);
+        sc_reduce(wide);
+        memcpy(a[i], wide, 32);
+        gen_random_bytes(64, wide);
+        sc_reduce(wide);
+        memcpy(b[i], wide, 32);
+        ge_scalarmult_base(&A[i], wide);
+        ge_double_scalarmult_base_vartime(&r, a[i], &A[i], b[i]);
+        ge_tobytes(expected[i], &r);
+    }
+
+    printf("\nwindow   table KiB   build ms   us/mult   check\n");
+    printf("ge_Bi    %9.1f   %8s   %7.2f   %s\n", ge_double_scalarmult_base_table_size(0) / 1024.0,
+        "-", bench_double_scalarmult(a, A, b), "ok");
+
+    for (int w = 6; w <= 14; w++) {
+        double start = now();
+        if (ge_double_scalarmult_base_init(w) != 0) {
+            printf("%-7d  init failed\n", w);
+            continue;
+        }
+        double build = now() - start;
+
+        bool ok = check_double_scalarmult(a, A, b, expected);
+        printf("%-7d  %9.1f   %8.1f   %7.2f   %s\n", w, ge_double_scalarmult_base_table_size(w) / 1024.0,
+            build * 1e3, bench_double_scalarmult(a, A, b), ok ? "ok" : "FAILED");
+    }
+
+    ge_double_scalarmult_base_init(0);
+    free(a);
+    free(b);
+    free(expected);
+    free(A);
+}
+
+int main() {
+    random_seed("bench", 5);    //The same inputs on every run
+    bench_base_tables();
+    bench_vartime_tables();
+
+    return 0;
+}
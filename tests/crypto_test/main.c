@@ -6,11 +6,16 @@
 #include <string.h>
 #include <err.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #include "../../src/crypto/keys.h"
 #include "../../src/crypto/hash/hash.h"
 #include "../../src/crypto/signatures.h"
 #include "../../src/crypto/rangeproofs.h"
+#include "../../src/crypto/pointcache.h"
+#include "../../src/crypto/random.h"
+#include "../../src/crypto/stealth.h"
+#include "../../src/crypto/subaddress.h"
 #include "../../src/utils/utils.h"
 
 //Longest line in tests.txt is 49569
@@ -183,6 +188,593 @@ void test_rangeproof() {
     generateBorromean(xv,P1v,P2v,indi,&bsig);
     
     res = verifyBorromean(P1v,P2v,&bsig);
+
+    //No point has y = 2, an invalid encoding must not verify
+    memset(P2v[5], 0, 32);
+    P2v[5][0] = 2;
+    res = res && !verifyBorromean(P1v,P2v,&bsig);
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_point_cache() {
+    printf("Testing point cache...\n");
+    int n = 64;
+    public_key pubs[n];
+    secret_key temp;
+    unsigned char out[32], bad[32];
+    ge_p3 p;
+    uint64_t hits, misses;
+    bool res = point_cache_init(32);    //Smaller than n, so entries are evicted
+
+    for (size_t i = 0; i < n; i++) {
+        generate_keys(pubs[i], temp);
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < n; i++) {
+            res = res && point_cache_frombytes(&p, pubs[i]) == 0;
+            ge_p3_tobytes(out, &p);
+            res = res && memcmp(out, pubs[i], 32) == 0;
+        }
+    }
+    point_cache_stats(&hits, &misses);
+    res = res && hits + misses == 2*n;
+
+    //With room for every key in each of the 16 shards nothing is evicted, so
+    //only the first lookup of a key misses
+    res = res && point_cache_init(16*n);
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < n; i++) {
+            res = res && point_cache_frombytes(&p, pubs[i]) == 0;
+            ge_p3_tobytes(out, &p);
+            res = res && memcmp(out, pubs[i], 32) == 0;
+        }
+    }
+    point_cache_stats(&hits, &misses);
+    res = res && hits == n && misses == n;
+
+    //Invalid encodings are remembered as invalid
+    do {
+        random_scalar(bad);
+    } while (ge_frombytes_vartime(&p, bad) == 0);
+    res = res && point_cache_frombytes(&p, bad) != 0;
+    res = res && point_cache_frombytes(&p, bad) != 0;
+    point_cache_stats(&hits, &misses);
+    res = res && hits == n + 1 && misses == n + 1;
+
+    point_cache_init(0);
+
+    //Key images computed through the H_p cache match the uncached ones
+    key_image images[8], cached;
+    for (size_t i = 0; i < 8; i++) {
+        generate_key_image(temp, pubs[i], images[i]);
+    }
+    res = res && hp_cache_init(16*8);
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < 8; i++) {
+            generate_key_image(temp, pubs[i], cached);
+            res = res && memcmp(images[i], cached, 32) == 0;
+        }
+    }
+    hp_cache_stats(&hits, &misses);
+    res = res && hits == 8 && misses == 8;
+    hp_cache_init(0);
+
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+//Limbs of fe for the selected backend, see crypto-ops.h
+#if defined(CRYPTO_OPS_FE51)
+#define FE_LIMBS 5
+#define FE_LIMB_BITS(i) 51
+#else
+#define FE_LIMBS 10
+#define FE_LIMB_BITS(i) ((i) % 2 == 0 ? 26 : 25)
+#endif
+
+void test_fe_invert() {
+    printf("Testing field inversion...\n");
+    fe x, a, b;
+    unsigned char ab[32], bb[32], one[32] = {1}, zero[32] = {0};
+    uint64_t r;
+    bool res = true;
+
+    //0, 1, p - 1, p, 2^255 - 1, then random limbs with a bit more than a
+    //reduced element has
+    for (int k = 0; k < 1005; k++) {
+        for (int i = 0; i < FE_LIMBS; i++) {
+            uint64_t full = (1ULL << FE_LIMB_BITS(i)) - 1;
+            switch (k) {
+                case 0: x[i] = 0; break;
+                case 1: x[i] = i == 0; break;
+                case 2: x[i] = i == 0 ? full - 19 : full; break;
+                case 3: x[i] = i == 0 ? full - 18 : full; break;
+                case 4: x[i] = full; break;
+                default:
+                    gen_random_bytes(sizeof(r), &r);
+                    x[i] = r & (2*full + 1);
+            }
+        }
+        fe_invert(a, x);
+        fe_invert_chain(b, x);
+        fe_tobytes(ab, a);
+        fe_tobytes(bb, b);
+        res = res && memcmp(ab, bb, 32) == 0;
+        if (k == 0 || k == 3) {
+            res = res && memcmp(ab, zero, 32) == 0;     //p is 0 as well
+        } else if (k == 1) {
+            res = res && memcmp(ab, one, 32) == 0;
+        }
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_sc_invert() {
+    printf("Testing scalar inversion...\n");
+    int n = 100;
+    ec_scalar a[n], inv[n], t, one;
+    bool res = true;
+
+    sc_0(one);
+    one[0] = 1;
+    for (size_t i = 0; i < n; i++) {
+        random_scalar(a[i]);
+    }
+    sc_0(a[n/2]);
+    sc_batch_invert(inv, (const unsigned char (*)[32]) a, n);
+
+    for (size_t i = 0; i < n; i++) {
+        sc_invert(t, a[i]);
+        res = res && memcmp(t, inv[i], 32) == 0;
+        sc_mul(t, a[i], inv[i]);
+        if (i == n/2) {
+            res = res && !sc_isnonzero(inv[i]);
+        } else {
+            res = res && memcmp(t, one, 32) == 0;
+        }
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_hash_to_ec_batch() {
+    printf("Testing batched hash to point...\n");
+    int n = 23;         //Not a multiple of four
+    public_key in[n];
+    ge_p3 out[n], single;
+    ec_point a, b;
+    bool res = true;
+
+    for (size_t i = 0; i < n; i++) {
+        random_scalar(in[i]);
+    }
+    hash_to_ec_batch((const unsigned char (*)[32]) in, n, out);
+
+    for (size_t i = 0; i < n; i++) {
+        hash_to_ec(in[i], 32, &single);
+        ge_p3_tobytes(a, &out[i]);
+        ge_p3_tobytes(b, &single);
+        res = res && memcmp(a, b, 32) == 0;
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+static bool ge_p3_equal(const ge_p3* a, const ge_p3* b) {
+    ec_point x, y;
+    ge_p3_tobytes(x, a);
+    ge_p3_tobytes(y, b);
+    return memcmp(x, y, 32) == 0;
+}
+
+void test_point_batch() {
+    printf("Testing batched point multiplication...\n");
+    size_t sizes[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 23};
+    ec_scalar a[23], b[23];
+    ge_p3 A[23], r[23], single;
+    bool res = true;
+
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        size_t n = sizes[k];
+        for (size_t i = 0; i < n; i++) {
+            random_scalar(b[i]);
+            ge_scalarmult_base(&A[i], b[i]);
+            gen_random_bytes(32, a[i]);
+            gen_random_bytes(32, b[i]);
+            a[i][31] &= 0x7f;                   //Largest allowed by radix 16
+            b[i][31] &= 0x7f;
+        }
+        a[0][31] = 0x7f;
+
+        ge_scalarmult_base_batch(r, (const unsigned char (*)[32]) a, n);
+        for (size_t i = 0; i < n; i++) {
+            ge_scalarmult_base(&single, a[i]);
+            res = res && ge_p3_equal(&r[i], &single);
+        }
+
+        ge_scalarmult_p3_batch(r, (const unsigned char (*)[32]) a, A, n);
+        for (size_t i = 0; i < n; i++) {
+            ge_scalarmult_p3(&single, a[i], &A[i]);
+            res = res && ge_p3_equal(&r[i], &single);
+        }
+
+        //Full 256-bit scalars, in some groups of four but not all, take the
+        //single path of the vartime batch
+        for (size_t i = 0; i < n; i++) {
+            if (i % 8 == 1) {
+                a[i][31] |= 0x80;
+            }
+            if (i % 8 == 6) {
+                b[i][31] |= 0x80;
+            }
+        }
+        ge_double_scalarmult_base_vartime_p3_batch(r, (const unsigned char (*)[32]) a, A, (const unsigned char (*)[32]) b, n);
+        for (size_t i = 0; i < n; i++) {
+            ge_double_scalarmult_base_vartime_p3(&single, a[i], &A[i], b[i]);
+            res = res && ge_p3_equal(&r[i], &single);
+        }
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_multiscalarmult() {
+    printf("Testing multi-scalar multiplication...\n");
+    //Straus below GE_MSM_PIPPENGER (128) points, Pippenger from there
+    size_t sizes[] = {0, 1, 2, 33, 128, 300};
+    size_t max = 300;
+    unsigned char (*a)[32] = malloc(max * 32);
+    ge_p3* A = malloc(max * sizeof(ge_p3));
+    ge_p3 r, rv, sum, t;
+    ge_cached c;
+    ge_p1p1 p1;
+    ec_scalar s;
+    bool res = a != NULL && A != NULL;
+
+    for (size_t k = 0; res && k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        size_t n = sizes[k];
+        for (size_t i = 0; i < n; i++) {
+            gen_random_bytes(32, a[i]);
+            a[i][31] &= 0x7f;
+            switch (i % 5) {
+                case 1:                             //Zero scalar
+                    memset(a[i], 0, 32);
+                    break;
+                case 2:                             //Largest allowed, 2^255 - 1
+                    memset(a[i], 0xff, 32);
+                    a[i][31] = 0x7f;
+                    break;
+                case 3:                             //Small, as for amounts
+                    memset(a[i], 0, 32);
+                    a[i][0] = (unsigned char) i;
+                    break;
+            }
+            if (i % 7 == 4) {                       //Repeated point
+                A[i] = A[i - 1];
+            } else {
+                random_scalar(s);
+                ge_scalarmult_base(&A[i], s);
+            }
+        }
+
+        sum = ge_p3_identity;
+        for (size_t i = 0; i < n; i++) {
+            ge_scalarmult_p3(&t, a[i], &A[i]);
+            ge_p3_to_cached(&c, &t);
+            ge_add(&p1, &sum, &c);
+            ge_p1p1_to_p3(&sum, &p1);
+        }
+        ge_multiscalarmult(&r, (const unsigned char (*)[32]) a, A, n);
+        ge_multiscalarmult_vartime(&rv, (const unsigned char (*)[32]) a, A, n);
+        res = res && ge_p3_equal(&r, &sum) && ge_p3_equal(&rv, &sum);
+    }
+    free(a);
+    free(A);
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_scalarmult8_batch() {
+    printf("Testing batched fixed scalar multiplication...\n");
+    int n = 23;
+    ec_scalar a, b;
+    ec_point B[n], out[n], single;
+    bool valid[n];
+    bool res = true;
+
+    random_scalar(a);
+    for (size_t i = 0; i < n; i++) {
+        random_scalar(b);
+        scalarMultBase(B[i], b);
+    }
+    res = scalarMult8_batch(out, valid, a, B, n);
+
+    for (size_t i = 0; i < n; i++) {
+        scalarMult8(single, a, B[i]);
+        res = res && valid[i] && memcmp(single, out[i], 32) == 0;
+    }
+
+    //No point has y = 2, it is reported and the others are still computed
+    memset(B[4], 0, 32);
+    B[4][0] = 2;
+    memset(out, 0, sizeof(out));
+    res = res && !scalarMult8_batch(out, valid, a, B, n) && !valid[4];
+    for (size_t i = 0; i < n; i++) {
+        if (i != 4) {
+            scalarMult8(single, a, B[i]);
+            res = res && valid[i] && memcmp(single, out[i], 32) == 0;
+        }
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_scan_stealth_tx() {
+    printf("Testing transaction scanning...\n");
+    int n = 6;
+    public_key A, B, A2, B2, R, pubs[n], D[n], single;
+    secret_key a, b, a2, b2, priv, zero = {0};
+    ec_scalar scalars[n];
+    stealth_address addr;
+    bool owned[n];
+    bool res = true;
+
+    generate_keys(A, a);
+    generate_keys(B, b);
+    generate_keys(A2, a2);
+    generate_keys(B2, b2);
+
+    //Outputs 0, 2 and 5 are ours and the others another wallet's, all with one r
+    for (size_t i = 0; i < n; i++) {
+        bool ours = i == 0 || i == 2 || i == 5;
+        generateStealth(ours ? A : A2, ours ? B : B2, &addr, i == 0, i, false);
+        memcpy(pubs[i], addr.pub, 32);
+    }
+    memcpy(R, addr.R, 32);
+
+    //No point has y = 2, output 4 can not be ours and has no D
+    memset(pubs[4], 0, 32);
+    pubs[4][0] = 2;
+
+    memset(D, 0xff, sizeof(D));
+    res = scanStealthTx(owned, scalars, D, pubs, NULL, n, R, a, B) == 3;
+    for (size_t i = 0; i < n; i++) {
+        memset(single, 0, 32);
+        res = res && owned[i] == isStealthMine(single, pubs[i], R, a, B, i);
+        res = res && memcmp(D[i], single, 32) == 0;
+        getStealthKey(priv, R, a, zero, i);     //H(aR || i)
+        res = res && memcmp(scalars[i], priv, 32) == 0;
+    }
+    res = res && owned[0] && owned[2] && owned[5];
+
+    memset(R, 0, 32);
+    R[0] = 2;
+    res = res && scanStealthTx(owned, scalars, D, pubs, NULL, n, R, a, B) == -1;
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_subaddress_table() {
+    printf("Testing subaddress table...\n");
+    public_key A, B, D, C, other;
+    secret_key a, b;
+    subaddress_index index;
+    subaddress_table t;
+    bool res;
+
+    generate_keys(A, a);
+    generate_keys(B, b);
+    res = subaddress_table_init(&t, a, B, 2, 8, 2);
+
+    //A subaddress in the window, the main spend key and a key that is neither
+    generate_subaddress(D, C, B, a, generate_subaddress_index(1, 5));
+    res = res && subaddress_table_lookup(&t, D, &index) && index.major == 1 && index.minor == 5;
+    res = res && subaddress_table_lookup(&t, B, &index) && index.major == 0 && index.minor == 0;
+    generate_keys(other, b);
+    res = res && !subaddress_table_lookup(&t, other, &index);
+
+    //A match well inside the window leaves it as it is
+    generate_subaddress(D, C, B, a, generate_subaddress_index(0, 1));
+    res = res && subaddress_table_match(&t, D, &index) && index.major == 0 && index.minor == 1;
+    res = res && t.majors == 2 && t.minors == 8;
+
+    //One within half a lookahead of the edge grows it a lookahead past the match
+    generate_subaddress(D, C, B, a, generate_subaddress_index(1, 6));
+    res = res && subaddress_table_match(&t, D, &index) && index.major == 1 && index.minor == 6;
+    res = res && t.majors == 3 && t.minors == 14;
+    generate_subaddress(D, C, B, a, generate_subaddress_index(2, 13));
+    res = res && subaddress_table_lookup(&t, D, &index) && index.major == 2 && index.minor == 13;
+    res = res && !subaddress_table_lookup(&t, other, &index);
+
+    subaddress_table_free(&t);
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_subaddress_range() {
+    printf("Testing subaddress range generation...\n");
+    int begin = 3, end = 140;   //Past one batch of 64, and not a multiple of 4
+    int n = end - begin;
+    public_key A, B, D1, C1, D[n], C[n];
+    secret_key a, b;
+    int threads[2] = {1, 3};
+    bool res = true;
+
+    generate_keys(A, a);
+    generate_keys(B, b);
+    for (int k = 0; k < 4; k++) {
+        bool withC = k % 2 == 1;
+        memset(D, 0, sizeof(D));
+        memset(C, 0, sizeof(C));
+        res = res && generate_subaddress_range(a, B, 2, begin, end, D, withC ? C : NULL, threads[k / 2]);
+        for (int i = 0; i < n; i++) {
+            generate_subaddress(D1, C1, B, a, generate_subaddress_index(2, begin + i));
+            res = res && memcmp(D[i], D1, 32) == 0;
+            if (withC) {
+                res = res && memcmp(C[i], C1, 32) == 0;
+            }
+        }
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_view_tag() {
+    printf("Testing view tags...\n");
+    int n = 4;
+    ec_point derivation;
+    unsigned char tags[3] = {0x76, 0xd6, 0x87}, view_tags[n];
+    public_key A, B, R, pubs[n], D[n], single;
+    secret_key a, b;
+    ec_scalar scalars[n];
+    stealth_address addr, plain;
+    bool owned[n];
+    bool res = true;
+
+    //Known answers from Monero's tests.txt
+    hexStrToBytes("0fc47054f355ced4d67de73bfa12e4c78ff19089548fffa7d07a674741860f97", derivation, 64);
+    for (size_t i = 0; i < 3; i++) {
+        res = res && derivation_to_view_tag(derivation, i) == tags[i];
+    }
+
+    //Every output is ours, the tag only changes which ones are found
+    generate_keys(A, a);
+    generate_keys(B, b);
+    for (size_t i = 0; i < n; i++) {
+        generateStealthViewTag(A, B, &addr, i == 0, i, false);
+        memcpy(pubs[i], addr.pub, 32);
+        view_tags[i] = addr.view_tag;
+        memcpy(plain.r, addr.r, 32);
+        generateStealth(A, B, &plain, false, i, false);
+        res = res && memcmp(plain.pub, addr.pub, 32) == 0 && memcmp(plain.R, addr.R, 32) == 0;
+    }
+    memcpy(R, addr.R, 32);
+    res = res && isStealthMineViewTag(single, pubs[2], R, a, B, 2, view_tags[2]);
+    res = res && !isStealthMineViewTag(single, pubs[2], R, a, B, 2, view_tags[2] ^ 1);
+
+    view_tags[2] ^= 1;
+    memset(D, 0xff, sizeof(D));
+    res = res && scanStealthTx(owned, scalars, D, pubs, view_tags, n, R, a, B) == n - 1;
+    memset(single, 0, 32);
+    for (size_t i = 0; i < n; i++) {
+        res = res && owned[i] == (i != 2) && memcmp(D[i], single, 32) == 0;
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_keccak() {
+    printf("Testing keccak...\n");
+    //Empty, short, one whole lane block (fast path), a full block and two blocks
+    size_t lens[5] = {0, 3, 64, 136, 200};
+    char* expected[5] = {
+        "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470",
+        "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45",
+        "002030bde3d4cf89919649775cd71875c4d0ab1708a380e03fefc3a28aa24831",
+        "7ce759f1ab7f9ce437719970c26b0a66ff11fe3e38e17df89cf5d29c7d7f807e",
+        "bfb0aa97863e797943cf7c33bb7e880bb4543f3d2703c0923c6901c2af57b890"
+    };
+    unsigned char in[200], hash[32], want[32], full[200];
+    bool res = true;
+
+    for (size_t i = 0; i < 200; i++) {
+        in[i] = i;
+    }
+    for (size_t i = 0; i < 5; i++) {
+        //"abc" rather than 0, 1, 2
+        unsigned char* data = i == 1 ? (unsigned char*) "abc" : in;
+        cn_fast_hash(data, lens[i], hash);
+        keccak1600(data, lens[i], full);
+        hexStrToBytes(expected[i], want, 64);
+        res = res && memcmp(hash, want, 32) == 0 && memcmp(full, want, 32) == 0;
+
+        //The same through the incremental interface, a few bytes at a time,
+        //from a clone of a state that has absorbed the first byte
+        keccak_ctx ctx, clone;
+        keccak_init(&ctx, HASH_SIZE);
+        keccak_update(&ctx, data, lens[i] > 0);
+        keccak_clone(&clone, &ctx);
+        for (size_t j = lens[i] > 0; j < lens[i]; j += 7) {
+            keccak_update(&clone, data + j, lens[i] - j < 7 ? lens[i] - j : 7);
+        }
+        keccak_final(&clone, hash);
+        res = res && memcmp(hash, want, 32) == 0;
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_hash_batch() {
+    printf("Testing batched keccak...\n");
+    //Both sides of the block size and of the 32/64 byte fast path
+    size_t lens[6] = {0, 32, 64, 135, 136, 300};
+    int n = 7;          //Four at a time and three on their own
+    unsigned char in[7 * 300], full[4][200], want[200];
+    ec_scalar out[7], single;
+    const uint8_t* ins[4];
+    uint8_t* outs[4];
+    bool res = true;
+
+    for (size_t i = 0; i < sizeof(in); i++) {
+        in[i] = i * 131 + 7;
+    }
+    for (size_t i = 0; i < 6; i++) {
+        hash_to_scalar_batch(in, lens[i], n, out);
+        for (size_t j = 0; j < n; j++) {
+            hash_to_scalar(in + j * lens[i], lens[i], single);
+            res = res && memcmp(single, out[j], 32) == 0;
+        }
+
+        for (size_t j = 0; j < 4; j++) {
+            ins[j] = in + j * lens[i];
+            outs[j] = full[j];
+        }
+        keccak_x4(ins, lens[i], outs, 200);
+        for (size_t j = 0; j < 4; j++) {
+            keccak1600(ins[j], lens[i], want);
+            res = res && memcmp(full[j], want, 200) == 0;
+        }
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+static void* random_thread(void* arg) {
+    random_scalar_batch((ec_scalar*) arg, 64);
+    return NULL;
+}
+
+void test_random_threads() {
+    printf("Testing random scalars from several threads...\n");
+    ec_scalar out[4][64];
+    pthread_t threads[4];
+    bool res = true;
+
+    for (size_t i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, random_thread, out[i]);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    //All reduced and no two alike, within or across threads
+    ec_scalar* all = out[0];
+    for (size_t i = 0; i < 4 * 64; i++) {
+        res = res && sc_check(all[i]) == 0;
+        for (size_t j = 0; j < i; j++) {
+            res = res && memcmp(all[i], all[j], 32) != 0;
+        }
+    }
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
+void test_random_seed() {
+    printf("Testing seeded random generation...\n");
+    key C[3], mask[3];
+    range_proof proof[3];
+    bool res = true;
+
+    //The same seed gives the same proof, the system seed a different one
+    for (size_t i = 0; i < 3; i++) {
+        if (i < 2) {
+            random_seed("range proof", 11);
+        } else {
+            random_unseed();
+        }
+        proveRange(C[i], mask[i], 1234567, &proof[i]);
+        res = res && verifyRange(C[i], &proof[i]);
+    }
+    res = res && memcmp(C[0], C[1], 32) == 0 && memcmp(mask[0], mask[1], 32) == 0;
+    res = res && memcmp(&proof[0], &proof[1], sizeof(range_proof)) == 0;
+    res = res && memcmp(mask[0], mask[2], 32) != 0;
     printf("Verification result: %s\n", res ? "true" : "false");
 }
 
@@ -328,6 +920,21 @@ int main() {
     //test_ring_sig();
     test_mlsag();
     test_rangeproof();
+    test_point_cache();
+    test_fe_invert();
+    test_sc_invert();
+    test_hash_to_ec_batch();
+    test_point_batch();
+    test_scalarmult8_batch();
+    test_multiscalarmult();
+    test_scan_stealth_tx();
+    test_view_tag();
+    test_subaddress_table();
+    test_subaddress_range();
+    test_keccak();
+    test_hash_batch();
+    test_random_threads();
+    test_random_seed();
 
     return 0;
 }
\ No newline at end of file
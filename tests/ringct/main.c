@@ -11,6 +11,7 @@
 #include "../../src/crypto/hash/hash.h"
 #include "../../src/crypto/signatures.h"
 #include "../../src/crypto/rangeproofs.h"
+#include "../../src/crypto/crypto_math/crypto-ops.h"
 #include "../../src/utils/utils.h"
 
 //Longest line in tests.txt is 49569
@@ -135,6 +136,31 @@ void test_rangeproof() {
     printf("Verification result: %s\n", res ? "true" : "false");
 }
 
+void test_commitment_balance() {
+    printf("Testing commitment balance...\n");
+    uint64_t amounts[2] = {1000, 2345};
+    uint64_t fee = 17;
+    key outPk[2], masks[2], pseudoOut, pseudoMask, pseudoAmount;
+    range_proof proof;
+
+    proveRange(outPk[0], masks[0], amounts[0], &proof);
+    proveRange(outPk[1], masks[1], amounts[1], &proof);
+
+    //pseudoOut = (mask_0 + mask_1)*G + (amount_0 + amount_1 + fee)*H
+    sc_add(pseudoMask, masks[0], masks[1]);
+    d2h(pseudoAmount, amounts[0] + amounts[1] + fee);
+    addKeys_double_multBase(pseudoOut, pseudoMask, pseudoAmount, (unsigned char*) H);
+
+    bool res = verifyCommitmentBalance(&pseudoOut, 1, outPk, 2, fee);
+    res = res && !verifyCommitmentBalance(&pseudoOut, 1, outPk, 2, fee + 1);
+
+    //No point has y = 2
+    memset(outPk[1], 0, 32);
+    outPk[1][0] = 2;
+    res = res && !verifyCommitmentBalance(&pseudoOut, 1, outPk, 2, fee);
+    printf("Verification result: %s\n", res ? "true" : "false");
+}
+
 void ctskpkGen(uint64_t amount) {
     
 }
@@ -146,6 +172,7 @@ void test_rangeproof2() {
 int main() {
     test_mlsag();
     test_rangeproof();
+    test_commitment_balance();
 
     return 0;
 }
\ No newline at end of file